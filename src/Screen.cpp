@@ -1,12 +1,24 @@
 #include "Screen.h"
 #include "global.h"
 #include <GL/glx.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <cmath>
 #include <cstdio>
-#include <fstream>
 #include <filesystem>
+#include <limits>
 #include "literal.h"
+#include "accelerator/accelerator.h"
+#include "gl/buffer.h"
 #include "gl/program.h"
 #include "gl/shader.h"
+#include "scene/cluster.h"
+#include "scene/meshlet.h"
+#include "scene/description.h"
+#include "scene/quantize.h"
+#include "scene/scene.h"
+#include "tuner.h"
 
 namespace dragiyski::raytrace
 {
@@ -138,11 +150,139 @@ namespace dragiyski::raytrace
         }
 
         std::filesystem::path projectDir(PROJECT_SOURCE_DIR);
+
+        // Default tile of the per-pixel compute kernels, see var/raytrace/tile.glsl.
+        constexpr tuner::local_size defaultLocalSize = {8, 8};
+
+        // Largest scene whose brute force frames are included in the benchmark.
+        constexpr std::size_t benchmarkBruteForceLimit = 4096;
+
+        // Number of timed dispatches per candidate while tuning.
+        constexpr int tuneRepeat = 4;
+
+        // Edge of the screen tiles of --primary binned, in pixels (see var/raytrace/bin.glsl).
+        constexpr GLsizei binSize = 16;
+
+        // Work group of the per-primitive bin_build.glsl.
+        constexpr GLuint binBuildLocalSize = 64;
+
+        GLuint createComputeProgram(const char *filename, const tuner::local_size &localSize, gl::shader::define_map defines = {})
+        {
+            defines["LOCAL_SIZE_X"] = std::to_string(localSize[0]);
+            defines["LOCAL_SIZE_Y"] = std::to_string(localSize[1]);
+            return gl::program::create(
+                gl::shader::fromFile(
+                    GL_COMPUTE_SHADER,
+                    std::filesystem::resolve(filename, projectDir).c_str(),
+                    defines));
+        }
+
+        // Splits interleaved vertices into the position and attribute buffers of scene.glsl, a batch at a time.
+        void createVertexStreams(std::span<const Vertex> vertices, GLuint &positions, GLuint &attributes)
+        {
+            auto count = std::max<std::size_t>(vertices.size(), 1);
+            glCreateBuffers(1, &positions);
+            glNamedBufferStorage(positions, GLsizeiptr(count * sizeof(scene::Position)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glCreateBuffers(1, &attributes);
+            glNamedBufferStorage(attributes, GLsizeiptr(count * sizeof(scene::Attributes)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            scene::splitVertices(vertices, [&](std::size_t first, std::span<const scene::Position> batchPositions, std::span<const scene::Attributes> batchAttributes) {
+                glNamedBufferSubData(positions, GLintptr(first * sizeof(scene::Position)), GLsizeiptr(batchPositions.size_bytes()), batchPositions.data());
+                glNamedBufferSubData(attributes, GLintptr(first * sizeof(scene::Attributes)), GLsizeiptr(batchAttributes.size_bytes()), batchAttributes.data());
+            });
+        }
+
+        // Depth of the visibility buffer is rasterNear over the distance along the view direction: reversed and without a
+        // far plane, so that float depth keeps its precision in the distance. Only what is closer than this is clipped.
+        constexpr GLfloat rasterNear = 1e-4f;
+
+        // Image plane of the camera rays (see var/raytrace/camera.glsl): its half extents, with the shorter one 1, and its
+        // distance from the eye, from the field of view across the diagonal.
+        struct View
+        {
+            GLfloat size[2];
+            GLfloat radius;
+        };
+
+        View cameraView(const scene::Camera &camera, GLsizei width, GLsizei height)
+        {
+            auto minSize = std::min(width, height);
+            float fieldOfView = camera.field_of_view / 180.0 * std::acos(-1);
+            View view;
+            view.size[0] = float(width) / float(minSize);
+            view.size[1] = float(height) / float(minSize);
+            float viewLength = std::sqrt(view.size[0] * view.size[0] + view.size[1] * view.size[1]);
+            view.radius = viewLength / std::tan(fieldOfView * 0.5);
+            return view;
+        }
+
+        // Camera uniform block of var/raytrace/camera.glsl (std140).
+        struct CameraBlock
+        {
+            GLfloat origin[3];
+            GLfloat radius;
+            GLfloat direction[3];
+            GLfloat roll;
+            GLfloat view_size[2];
+            GLint screen_size[2];
+        };
+
+        // Row-major clip transform of the visibility buffer, for the camera basis of cameraRay. The ray of a pixel goes
+        // through its lower left corner; a shift of half a pixel moves that point to the pixel center, which is where the
+        // rasterizer samples. Clip z is rasterNear, w the distance along the view direction.
+        std::array<GLfloat, 16> viewProjection(const scene::Camera &camera, const View &view, GLsizei width, GLsizei height)
+        {
+            using vec3 = std::array<GLfloat, 3>;
+            auto dot = [](const vec3 &a, const vec3 &b) {
+                return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+            };
+            auto cross = [](const vec3 &a, const vec3 &b) {
+                return vec3{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+            };
+            auto normalize = [&](const vec3 &a) {
+                auto length = std::sqrt(dot(a, a));
+                return vec3{a[0] / length, a[1] / length, a[2] / length};
+            };
+            auto combine = [](GLfloat x, const vec3 &a, GLfloat y, const vec3 &b) {
+                return vec3{x * a[0] + y * b[0], x * a[1] + y * b[1], x * a[2] + y * b[2]};
+            };
+
+            auto forward = normalize({camera.direction[0], camera.direction[1], camera.direction[2]});
+            auto worldUp = std::abs(forward[1]) > 0.999f ? vec3{0.0f, 0.0f, -1.0f} : vec3{0.0f, 1.0f, 0.0f};
+            auto right = normalize(cross(forward, worldUp));
+            auto up = cross(right, forward);
+            float roll = camera.roll / 180.0 * std::acos(-1);
+            auto rolledRight = combine(std::cos(roll), right, std::sin(roll), up);
+            auto rolledUp = combine(std::cos(roll), up, -std::sin(roll), right);
+
+            vec3 origin = {camera.origin[0], camera.origin[1], camera.origin[2]};
+            vec3 rows[3] = {
+                combine(view.radius / view.size[0], rolledRight, 1.0f / float(width), forward),
+                combine(view.radius / view.size[1], rolledUp, 1.0f / float(height), forward),
+                forward,
+            };
+            std::array<GLfloat, 16> matrix = {};
+            for (int row : {0, 1, 3})
+            {
+                const auto &axis = rows[row == 3 ? 2 : row];
+                std::copy(axis.begin(), axis.end(), matrix.begin() + 4 * row);
+                matrix[4 * row + 3] = -dot(axis, origin);
+            }
+            matrix[4 * 2 + 3] = rasterNear;
+            return matrix;
+        }
+
+        // One invocation per pixel: the grid is rounded up to whole tiles of the program's local size.
+        void dispatchScreen(GLuint program, GLsizei width, GLsizei height)
+        {
+            GLint localSize[3];
+            glGetProgramiv(program, GL_COMPUTE_WORK_GROUP_SIZE, localSize);
+            glDispatchCompute((width + localSize[0] - 1) / localSize[0], (height + localSize[1] - 1) / localSize[1], 1);
+        }
     }
 
     std::map<uint32_t, std::shared_ptr<Screen>> Screen::window_screen_map;
 
-    std::shared_ptr<Screen> Screen::New(const char *title)
+    std::shared_ptr<Screen> Screen::New(const char *title, const Options &options)
     {
         if (!SDL_WasInit(SDL_INIT_VIDEO))
         {
@@ -223,13 +363,13 @@ namespace dragiyski::raytrace
             SDL_DestroyWindow(window);
             throw sdl_error(SDL_GetError());
         }
-        std::shared_ptr<Screen> ptr(new Screen(window, context));
+        std::shared_ptr<Screen> ptr(new Screen(window, context, options));
         window_screen_map[SDL_GetWindowID(window)] = ptr;
         return ptr;
     }
 
-    Screen::Screen(SDL_Window *window, SDL_GLContext context) // NOLINT(cppcoreguidelines-pro-type-member-init)
-        : m_window(window), m_context(context), m_is_initialized(false), m_need_resize(true)
+    Screen::Screen(SDL_Window *window, SDL_GLContext context, const Options &options) // NOLINT(cppcoreguidelines-pro-type-member-init)
+        : m_window(window), m_context(context), m_options(options), m_is_initialized(false), m_need_resize(true), m_need_tune(false)
     {
     }
 
@@ -272,6 +412,11 @@ namespace dragiyski::raytrace
         {
             resize();
         }
+        if (m_need_tune && std::min(g_screen_width, g_screen_height) > 0)
+        {
+            tune();
+            m_need_tune = false;
+        }
         paint();
     }
 
@@ -283,39 +428,21 @@ namespace dragiyski::raytrace
             throw sdl_error(SDL_GetError());
         }
 
+        g_description = scene::describe(
+            std::filesystem::resolve(m_options.scene, projectDir),
+            std::filesystem::resolve(std::filesystem::path("var/models/spheres.bin"), projectDir));
+        g_scene = scene::open(g_description, m_options.map_populate);
+        scene::QuantizedVertices quantized;
+        if (m_options.quantize)
         {
-            std::fstream file;
-            file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            auto filepath = std::filesystem::resolve(std::filesystem::path("var/models/cube.vbo.bin"), std::filesystem::path(PROJECT_SOURCE_DIR));
-            auto filepath_string = filepath.c_str();
-            file.open(filepath_string, std::fstream::binary | std::fstream::ate | std::fstream::in);
-            auto filesize = file.tellg();
-            if (filesize % sizeof(decltype(g_cube_vertices)::value_type) != 0)
-            {
-                throw std::runtime_error("Invalid cube VBO size");
-            }
-            file.seekg(0, std::ios::beg);
-            g_cube_vertices.resize(filesize / sizeof(decltype(g_cube_vertices)::value_type));
-            file.read(reinterpret_cast<char *>(g_cube_vertices.data()), filesize);
-        }
-        {
-            std::fstream file;
-            file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            auto filepath = std::filesystem::resolve(std::filesystem::path("var/models/cube.ibo.bin"), std::filesystem::path(PROJECT_SOURCE_DIR));
-            auto filepath_string = filepath.c_str();
-            file.open(filepath_string, std::fstream::binary | std::fstream::ate | std::fstream::in);
-            auto filesize = file.tellg();
-            if (filesize % sizeof(decltype(g_cube_triangles)::value_type) != 0)
-            {
-                throw std::runtime_error("Invalid cube VBO size");
-            }
-            file.seekg(0, std::ios::beg);
-            g_cube_triangles.resize(filesize / sizeof(decltype(g_cube_triangles)::value_type));
-            file.read(reinterpret_cast<char *>(g_cube_triangles.data()), filesize);
-        }
-        for (auto &vertex : g_cube_vertices)
-        {
-            vertex.location[2] -= 6.0;
+            quantized = scene::quantize(g_scene);
+            auto bytes = (quantized.positions.size() + quantized.attributes.size()) * sizeof(scene::QuantizedRecord);
+            fprintf(stderr, "[quantize]: %zu vertices, %zu bytes, was %zu bytes\n", g_scene.vertexCount(), bytes, g_scene.vertexCount() * sizeof(Vertex));
+            // Everything built on the CPU from here on sees the positions the kernels decode. The attributes are only
+            // needed for the upload.
+            g_scene.quantized_positions = g_scene.own(std::move(quantized.positions));
+            // Stored meshlets bound the stored positions.
+            g_scene.meshlets = {};
         }
 
         GLfloat vertexData[] = {
@@ -336,20 +463,59 @@ namespace dragiyski::raytrace
                 GL_FRAGMENT_SHADER,
                 std::filesystem::resolve("var/present/fragment.glsl", projectDir).c_str()));
 
-        g_program_clear = gl::program::create(
-            gl::shader::fromFile(
-                GL_COMPUTE_SHADER,
-                std::filesystem::resolve("var/raytrace/clear.glsl", projectDir).c_str()));
-
-        g_program_screen = gl::program::create(
-            gl::shader::fromFile(
-                GL_COMPUTE_SHADER,
-                std::filesystem::resolve("var/raytrace/screen.glsl", projectDir).c_str()));
+        auto kind = m_options.accelerator;
+        if (kind == AcceleratorKind::automatic)
+        {
+            // Small scenes are cheaper to test exhaustively than to traverse: a BVH costs more than it saves.
+            kind = g_scene.primitiveCount() <= m_options.brute_force_threshold ? AcceleratorKind::brute : AcceleratorKind::bvh;
+        }
+        m_kind = kind;
+        m_resident = kind != AcceleratorKind::stream && kind != AcceleratorKind::meshlet;
+        m_accelerator = createAccelerator(kind);
+        fprintf(stderr, "[scene]: %zu triangles, %zu spheres, %s\n", g_scene.triangles.size(), g_scene.spheres.size(), m_accelerator->name().c_str());
+        compileKernels();
 
-        g_program_raytrace_triangle = gl::program::create(
-            gl::shader::fromFile(
-                GL_COMPUTE_SHADER,
-                std::filesystem::resolve("var/raytrace/shape/triangle.glsl", projectDir).c_str()));
+        // Streamed geometry reaches the GPU through the accelerator, cluster by cluster.
+        if (kind == AcceleratorKind::stream)
+        {
+            g_buffer_vertex = gl::buffer::createStorage(std::span<const scene::Position>());
+            g_buffer_vertex_attribute = gl::buffer::createStorage(std::span<const scene::Attributes>());
+        }
+        else if (m_options.quantize)
+        {
+            g_buffer_vertex = gl::buffer::createStorage(g_scene.quantized_positions);
+            g_buffer_vertex_attribute = gl::buffer::createStorage(quantized.attributes);
+        }
+        else if (g_scene.vertices.empty())
+        {
+            g_buffer_vertex = gl::buffer::createStorage(g_scene.positions);
+            g_buffer_vertex_attribute = gl::buffer::createStorage(g_scene.attributes);
+        }
+        else
+        {
+            createVertexStreams(g_scene.vertices, g_buffer_vertex, g_buffer_vertex_attribute);
+        }
+        g_buffer_triangle = gl::buffer::createStorage(m_resident ? g_scene.triangles : std::span<const scene::Triangle>());
+        g_buffer_sphere = gl::buffer::createStorage(g_scene.spheres);
+        glCreateBuffers(1, &g_buffer_shadow_counter);
+        glNamedBufferStorage(g_buffer_shadow_counter, sizeof(GLuint), nullptr, 0);
+        glCreateBuffers(1, &g_buffer_camera);
+        glNamedBufferStorage(g_buffer_camera, sizeof(CameraBlock), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        if (m_options.primary == PrimaryRays::raster)
+        {
+            // Vertices are pulled from the storage buffer, so the vertex array only holds the triangle indices.
+            glCreateVertexArrays(1, &g_array_visibility);
+            glVertexArrayElementBuffer(g_array_visibility, g_buffer_triangle);
+            glCreateFramebuffers(1, &g_framebuffer_visibility);
+            glCreateRenderbuffers(1, &g_renderbuffer_visibility_depth);
+        }
+        if (m_options.primary == PrimaryRays::binned)
+        {
+            // Most primitives of a large scene fall into a single tile; the buffer grows when the lists need more.
+            m_bin_capacity = GLuint(std::max<std::size_t>(2 * g_scene.primitiveCount(), 1));
+            glCreateBuffers(1, &g_buffer_bin_reference);
+            glNamedBufferStorage(g_buffer_bin_reference, m_bin_capacity * sizeof(GLuint), nullptr, 0);
+        }
 
         glGenBuffers(1, &g_buffer_vertex_screen);
         glGenBuffers(1, &g_buffer_index_screen);
@@ -370,15 +536,14 @@ namespace dragiyski::raytrace
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &g_texture_ray);
-        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &g_texture_trace);
         glCreateTextures(GL_TEXTURE_RECTANGLE, 1, &g_texture_screen);
-        glCreateTextures(GL_TEXTURE_RECTANGLE, 1, &g_debth_buffer);
-        glCreateTextures(GL_TEXTURE_RECTANGLE, 1, &g_stencil_buffer);
 
         glCreateQueries(GL_TIME_ELAPSED, 1, &g_query_time_measure);
+        glCreateQueries(GL_TIME_ELAPSED, 2, g_query_pass);
+        glCreateQueries(GL_TIMESTAMP, 2, g_query_frame);
 
         glClearColor(0.0, 0.0, 0.0, 1.0);
+        m_is_initialized = true;
     }
 
     void Screen::resize()
@@ -387,30 +552,29 @@ namespace dragiyski::raytrace
         SDL_GL_GetDrawableSize(m_window, &width, &height);
 
         glViewport(0, 0, width, height);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, g_texture_ray);
-        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, width, height, 2, 0, GL_RGBA, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, g_texture_trace);
-        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, width, height, 4, 0, GL_RGBA, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
         glBindTexture(GL_TEXTURE_RECTANGLE, g_texture_screen);
         glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
-        glBindTexture(GL_TEXTURE_RECTANGLE, g_debth_buffer);
-        glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, nullptr);
-        glBindTexture(GL_TEXTURE_RECTANGLE, g_stencil_buffer);
-        glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        if (m_options.primary == PrimaryRays::raster)
+        {
+            glNamedRenderbufferStorage(g_renderbuffer_visibility_depth, GL_DEPTH_COMPONENT32F, std::max(width, 1), std::max(height, 1));
+            glNamedFramebufferRenderbuffer(g_framebuffer_visibility, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_renderbuffer_visibility_depth);
+        }
+        if (m_options.primary == PrimaryRays::binned)
+        {
+            // The total, then an offset and a count per tile.
+            auto bins = GLsizeiptr((width + binSize - 1) / binSize) * ((height + binSize - 1) / binSize);
+            glDeleteBuffers(1, &g_buffer_bin);
+            glCreateBuffers(1, &g_buffer_bin);
+            glNamedBufferStorage(g_buffer_bin, sizeof(GLuint) + bins * 2 * sizeof(GLuint), nullptr, 0);
+            glClearNamedBufferData(g_buffer_bin, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        }
         glBindTexture(GL_TEXTURE_RECTANGLE, 0);
         g_screen_width = width;
         g_screen_height = height;
+        // The camera of the scene is fixed, only the screen changes it.
+        updateCamera();
+        buildGraph();
+        m_need_resize = false;
     }
 
     void Screen::paint()
@@ -425,109 +589,13 @@ namespace dragiyski::raytrace
 
         glBeginQuery(GL_TIME_ELAPSED, g_query_time_measure);
 
+        m_graph.execute();
         {
-            glUseProgram(g_program_clear);
-            glBindImageTexture(
-                0,
-                g_texture_trace,
-                0,
-                GL_TRUE,
-                0,
-                GL_WRITE_ONLY,
-                GL_RGBA32F);
-            glBindImageTexture(
-                1,
-                g_texture_screen,
-                0,
-                GL_TRUE,
-                0,
-                GL_WRITE_ONLY,
-                GL_RGBA32F);
-            glBindImageTexture(
-                2,
-                g_debth_buffer,
-                0,
-                GL_TRUE,
-                0,
-                GL_WRITE_ONLY,
-                GL_R32UI);
-            glBindImageTexture(
-                3,
-                g_stencil_buffer,
-                0,
-                GL_TRUE,
-                0,
-                GL_WRITE_ONLY,
-                GL_R32UI);
-            glDispatchCompute(g_screen_width, g_screen_height, 1);
-        }
-        {
-            float fieldOfView = 90.0 / 180.0 * std::acos(-1);
-            float viewSize[2] = {float(g_screen_width) / float(minSize), float(g_screen_height) / float(minSize)};
-            float viewLength = std::sqrt(viewSize[0] * viewSize[0] + viewSize[1] * viewSize[1]);
-            float screenRadius = viewLength / std::tan(fieldOfView * 0.5);
-            glUseProgram(g_program_screen);
-            glUniform2i(glGetUniformLocation(g_program_screen, "screenSize"), g_screen_width, g_screen_height);
-            glUniform2fv(glGetUniformLocation(g_program_screen, "viewSize"), 1, viewSize);
-            glUniform1f(glGetUniformLocation(g_program_screen, "screenRadius"), screenRadius);
-            glBindImageTexture(
-                0,
-                g_texture_ray,
-                0,
-                GL_TRUE,
-                0,
-                GL_READ_WRITE,
-                GL_RGBA32F);
-            glDispatchCompute(g_screen_width, g_screen_height, 1);
-        }
-        {
-            glUseProgram(g_program_raytrace_triangle);
-            for (auto &triangle : g_cube_triangles)
-            {
-                std::array<GLfloat, 3> normal = {
-                    g_cube_vertices[triangle[1]].location[1] * g_cube_vertices[triangle[0]].location[2] - g_cube_vertices[triangle[0]].location[1] * g_cube_vertices[triangle[1]].location[2],
-                    g_cube_vertices[triangle[1]].location[2] * g_cube_vertices[triangle[0]].location[0] - g_cube_vertices[triangle[0]].location[2] * g_cube_vertices[triangle[1]].location[0],
-                    g_cube_vertices[triangle[1]].location[0] * g_cube_vertices[triangle[0]].location[1] - g_cube_vertices[triangle[0]].location[0] * g_cube_vertices[triangle[1]].location[1],
-                };
-                GLfloat length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
-                normal[0] /= length;
-                normal[1] /= length;
-                normal[2] /= length;
-                GLfloat d = normal[0] * g_cube_vertices[triangle[0]].location[0] + normal[1] * g_cube_vertices[triangle[0]].location[1] + normal[2] * g_cube_vertices[triangle[0]].location[2];
-                glUniform4f(glGetUniformLocation(g_program_raytrace_triangle, "plane"), normal[0], normal[1], normal[2], d);
-                glUniform3fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[0].location"), 1, g_cube_vertices[triangle[0]].location);
-                glUniform3fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[0].normal"), 1, g_cube_vertices[triangle[0]].normal);
-                glUniform2fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[0].uv"), 1, g_cube_vertices[triangle[0]].uv);
-                glUniform3fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[1].location"), 1, g_cube_vertices[triangle[1]].location);
-                glUniform3fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[1].normal"), 1, g_cube_vertices[triangle[1]].normal);
-                glUniform2fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[1].uv"), 1, g_cube_vertices[triangle[1]].uv);
-                glUniform3fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[2].location"), 1, g_cube_vertices[triangle[2]].location);
-                glUniform3fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[2].normal"), 1, g_cube_vertices[triangle[2]].normal);
-                glUniform2fv(glGetUniformLocation(g_program_raytrace_triangle, "triangle[2].uv"), 1, g_cube_vertices[triangle[2]].uv);
-                glBindImageTexture(
-                    0,
-                    g_texture_ray,
-                    0,
-                    GL_TRUE,
-                    0,
-                    GL_READ_WRITE,
-                    GL_RGBA32F);
-                glBindImageTexture(
-                    1,
-                    g_texture_trace,
-                    0,
-                    GL_TRUE,
-                    0,
-                    GL_READ_WRITE,
-                    GL_RGBA32F);
-                glDispatchCompute(g_screen_width, g_screen_height, 1);
-            }
-        }
-        {
+            m_graph.use({graph::read(m_graph_screen, graph::Access::image)});
             glUseProgram(g_program_present);
             glBindImageTexture(
                 0,
-                g_texture_trace,
+                g_texture_screen,
                 0,
                 GL_FALSE,
                 0,
@@ -549,9 +617,772 @@ namespace dragiyski::raytrace
             glGetQueryObjectui64v(g_query_time_measure, GL_QUERY_RESULT, &time_elapsed);
             fprintf(stderr, "[frame.time][%d][%d]: %lu ns\n", g_screen_width, g_screen_height, time_elapsed);
         }
+        {
+            GLuint shadow_rays;
+            m_graph.use({graph::read(m_graph_shadow_counter, graph::Access::transfer)});
+            glGetNamedBufferSubData(g_buffer_shadow_counter, 0, sizeof(shadow_rays), &shadow_rays);
+            fprintf(stderr, "[frame.shadow_rays][%d][%d]: %u\n", g_screen_width, g_screen_height, shadow_rays);
+        }
 
         glFinish();
     }
 
+    void Screen::updateCamera()
+    {
+        const auto &camera = g_description.camera;
+        auto view = cameraView(camera, g_screen_width, g_screen_height);
+        CameraBlock block;
+        std::copy(std::begin(camera.origin), std::end(camera.origin), block.origin);
+        block.radius = view.radius;
+        std::copy(std::begin(camera.direction), std::end(camera.direction), block.direction);
+        block.roll = camera.roll / 180.0 * std::acos(-1);
+        std::copy(std::begin(view.size), std::end(view.size), block.view_size);
+        block.screen_size[0] = g_screen_width;
+        block.screen_size[1] = g_screen_height;
+        glNamedBufferSubData(g_buffer_camera, 0, sizeof(block), &block);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, g_buffer_camera);
+    }
+
+    void Screen::buildGraph()
+    {
+        // Every pass names what it touches; the graph orders the passes, puts the barriers between them and allocates
+        // the textures that do not outlive the frame. Scene buffers are never written by the GPU, so they are left out.
+        using graph::Access;
+        using graph::read;
+        using graph::write;
+        graph::Graph frame;
+        auto screen = frame.texture("screen");
+        auto counter = frame.buffer("shadow_counter");
+        if (m_options.pipeline == Pipeline::fused)
+        {
+            frame.pass("fused", {write(counter, Access::transfer), write(counter, Access::atomic), write(screen, Access::image)}, [this]() { passFused(); });
+        }
+        else
+        {
+            auto trace = frame.transient("trace", {GL_TEXTURE_2D_ARRAY, GL_RGBA32F, 4}, &g_texture_trace);
+            auto index = frame.transient("trace_index", {GL_TEXTURE_RECTANGLE, GL_R32UI}, &g_texture_trace_index);
+            auto depth = frame.transient("depth", {GL_TEXTURE_RECTANGLE, GL_R32F}, &g_debth_buffer);
+            auto shadow = frame.transient("shadow", {GL_TEXTURE_RECTANGLE, GL_R8}, &g_texture_shadow);
+            std::vector<graph::Use> gbuffer = {write(trace, Access::image), write(index, Access::image), write(depth, Access::image)};
+            auto with = [](std::vector<graph::Use> uses, std::initializer_list<graph::Use> more) {
+                uses.insert(uses.end(), more);
+                return uses;
+            };
+            switch (m_options.primary)
+            {
+            case PrimaryRays::raster:
+            {
+                auto visibility = frame.transient("visibility", {GL_TEXTURE_RECTANGLE, GL_R32UI}, &g_texture_visibility);
+                frame.pass("primary.raster", {write(visibility, Access::framebuffer)}, [this]() { passRaster(); });
+                frame.pass("primary.resolve", with(gbuffer, {read(visibility, Access::image)}), [this]() { passResolve(); });
+                break;
+            }
+            case PrimaryRays::binned:
+            {
+                auto bins = frame.buffer("bins");
+                auto references = frame.buffer("bin_references");
+                // The count pass reads the total of the previous frame back, then clears the bins.
+                frame.pass("primary.count", {read(bins, Access::transfer), write(bins, Access::transfer), write(bins, Access::storage)}, [this]() { passBinList(g_program_bin_count); });
+                frame.pass("primary.scan", {read(bins, Access::storage), write(bins, Access::storage)}, [this]() { passBinList(g_program_bin_scan); });
+                frame.pass("primary.fill", {read(bins, Access::storage), write(bins, Access::storage), write(references, Access::storage)}, [this]() { passBinList(g_program_bin_fill); });
+                frame.pass("primary.trace", with(gbuffer, {read(bins, Access::storage), read(references, Access::storage)}), [this]() { passBinTrace(); });
+                break;
+            }
+            default:
+                frame.pass("primary", gbuffer, [this]() { passTrace(); });
+                break;
+            }
+            frame.pass("shadow", {read(trace, Access::image), read(index, Access::image), write(shadow, Access::image), write(counter, Access::transfer), write(counter, Access::atomic)}, [this]() { passShadow(); });
+            frame.pass("light", {read(trace, Access::image), read(index, Access::image), read(shadow, Access::image), write(screen, Access::image)}, [this]() { passLight(); });
+        }
+        // The textures of the previous graph go first, so that they never exist next to the new ones.
+        m_graph = graph::Graph();
+        frame.compile(g_screen_width, g_screen_height);
+        m_graph = std::move(frame);
+        m_graph_screen = screen;
+        m_graph_shadow_counter = counter;
+        if (m_options.primary == PrimaryRays::raster)
+        {
+            glNamedFramebufferTexture(g_framebuffer_visibility, GL_COLOR_ATTACHMENT0, g_texture_visibility, 0);
+        }
+    }
+
+    void Screen::passTrace()
+    {
+        glUseProgram(g_program_trace);
+        glUniform1ui(glGetUniformLocation(g_program_trace, "triangleCount"), g_scene.triangles.size());
+        glUniform1ui(glGetUniformLocation(g_program_trace, "sphereCount"), g_scene.spheres.size());
+        glUniform4fv(glGetUniformLocation(g_program_trace, "meshColor"), 1, g_description.material.color);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g_buffer_triangle);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        // The streaming kernels have their cluster tree at binding 5 (see var/raytrace/scene.glsl).
+        if (m_kind != AcceleratorKind::stream)
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, g_buffer_vertex_attribute);
+        }
+        glBindImageTexture(
+            0,
+            g_texture_trace,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_RGBA32F);
+        glBindImageTexture(
+            1,
+            g_texture_trace_index,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R32UI);
+        glBindImageTexture(
+            2,
+            g_debth_buffer,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R32F);
+        m_accelerator->beginPass(g_screen_width, g_screen_height);
+        do
+        {
+            m_accelerator->bind(g_program_trace);
+            dispatchScreen(g_program_trace, g_screen_width, g_screen_height);
+        } while (m_accelerator->nextWave());
+    }
+
+    void Screen::passRaster()
+    {
+        // The rasterizer resolves the coherent camera rays: the visibility buffer gets the id of the closest primitive at
+        // every pixel, then the resolve kernel intersects only that primitive to write the G-buffer like passTrace.
+        auto view = cameraView(g_description.camera, g_screen_width, g_screen_height);
+        auto transform = viewProjection(g_description.camera, view, g_screen_width, g_screen_height);
+        GLuint noPrimitive[4] = {0, 0, 0, 0};
+        GLfloat farDepth = 0.0f;
+        glBindFramebuffer(GL_FRAMEBUFFER, g_framebuffer_visibility);
+        glClearBufferuiv(GL_COLOR, 0, noPrimitive);
+        glClearBufferfv(GL_DEPTH, 0, &farDepth);
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GREATER);
+        glBindVertexArray(g_array_visibility);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        if (!g_scene.triangles.empty())
+        {
+            glUseProgram(g_program_visibility_triangle);
+            glUniformMatrix4fv(glGetUniformLocation(g_program_visibility_triangle, "viewProjection"), 1, GL_TRUE, transform.data());
+            glDrawElements(GL_TRIANGLES, GLsizei(3 * g_scene.triangles.size()), GL_UNSIGNED_INT, reinterpret_cast<const void *>(0));
+        }
+        if (!g_scene.spheres.empty())
+        {
+            glUseProgram(g_program_visibility_sphere);
+            glUniformMatrix4fv(glGetUniformLocation(g_program_visibility_sphere, "viewProjection"), 1, GL_TRUE, transform.data());
+            glUniform1f(glGetUniformLocation(g_program_visibility_sphere, "rasterNear"), rasterNear);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 36, GLsizei(g_scene.spheres.size()));
+        }
+        glBindVertexArray(0);
+        glDisable(GL_DEPTH_TEST);
+        glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void Screen::passResolve()
+    {
+        glUseProgram(g_program_resolve);
+        glUniform1ui(glGetUniformLocation(g_program_resolve, "triangleCount"), g_scene.triangles.size());
+        glUniform1ui(glGetUniformLocation(g_program_resolve, "sphereCount"), g_scene.spheres.size());
+        glUniform4fv(glGetUniformLocation(g_program_resolve, "meshColor"), 1, g_description.material.color);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g_buffer_triangle);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, g_buffer_vertex_attribute);
+        glBindImageTexture(
+            0,
+            g_texture_trace,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_RGBA32F);
+        glBindImageTexture(
+            1,
+            g_texture_trace_index,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R32UI);
+        glBindImageTexture(
+            2,
+            g_debth_buffer,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R32F);
+        glBindImageTexture(
+            3,
+            g_texture_visibility,
+            0,
+            GL_TRUE,
+            0,
+            GL_READ_ONLY,
+            GL_R32UI);
+        // Only pixels on the edge of a primitive trace, so the accelerator is needed, but never in more than one wave.
+        m_accelerator->bind(g_program_resolve);
+        dispatchScreen(g_program_resolve, g_screen_width, g_screen_height);
+    }
+
+    void Screen::passBinList(GLuint program)
+    {
+        if (program == g_program_bin_count)
+        {
+            // The lists of the previous frame tell how much they need. Reading the total waits for that frame, which paint
+            // finishes anyway. Until the buffer has grown, tiles whose list did not fit trace through the accelerator.
+            GLuint total;
+            glGetNamedBufferSubData(g_buffer_bin, 0, sizeof(total), &total);
+            if (total > m_bin_capacity)
+            {
+                m_bin_capacity = total + total / 2;
+                glDeleteBuffers(1, &g_buffer_bin_reference);
+                glCreateBuffers(1, &g_buffer_bin_reference);
+                glNamedBufferStorage(g_buffer_bin_reference, GLsizeiptr(m_bin_capacity) * sizeof(GLuint), nullptr, 0);
+                fprintf(stderr, "[bin][%d][%d]: %u references, capacity %u\n", g_screen_width, g_screen_height, total, m_bin_capacity);
+            }
+            glClearNamedBufferData(g_buffer_bin, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g_buffer_triangle);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, g_buffer_bin);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, g_buffer_bin_reference);
+        glUseProgram(program);
+        glUniform2i(glGetUniformLocation(program, "screenSize"), g_screen_width, g_screen_height);
+        glUniform1ui(glGetUniformLocation(program, "binCapacity"), m_bin_capacity);
+        if (program == g_program_bin_scan)
+        {
+            glDispatchCompute(1, 1, 1);
+            return;
+        }
+        auto view = cameraView(g_description.camera, g_screen_width, g_screen_height);
+        auto transform = viewProjection(g_description.camera, view, g_screen_width, g_screen_height);
+        auto primitives = GLuint(g_scene.primitiveCount());
+        glUniform1ui(glGetUniformLocation(program, "triangleCount"), g_scene.triangles.size());
+        glUniform1ui(glGetUniformLocation(program, "sphereCount"), g_scene.spheres.size());
+        glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_TRUE, transform.data());
+        glDispatchCompute((primitives + binBuildLocalSize - 1) / binBuildLocalSize, 1, 1);
+    }
+
+    void Screen::passBinTrace()
+    {
+        glUseProgram(g_program_bin_trace);
+        glUniform1ui(glGetUniformLocation(g_program_bin_trace, "binCapacity"), m_bin_capacity);
+        glUniform1ui(glGetUniformLocation(g_program_bin_trace, "binLimit"), GLuint(std::min<std::size_t>(m_options.brute_force_threshold, std::numeric_limits<GLuint>::max())));
+        glUniform4fv(glGetUniformLocation(g_program_bin_trace, "meshColor"), 1, g_description.material.color);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g_buffer_triangle);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, g_buffer_vertex_attribute);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, g_buffer_bin);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, g_buffer_bin_reference);
+        glBindImageTexture(
+            0,
+            g_texture_trace,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_RGBA32F);
+        glBindImageTexture(
+            1,
+            g_texture_trace_index,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R32UI);
+        glBindImageTexture(
+            2,
+            g_debth_buffer,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R32F);
+        // Only crowded tiles and tiles whose list did not fit trace, which never takes more than one wave.
+        m_accelerator->bind(g_program_bin_trace);
+        dispatchScreen(g_program_bin_trace, g_screen_width, g_screen_height);
+    }
+
+
+    void Screen::passShadow()
+    {
+        // Shadow rays only need to know whether anything is in the way, so they get their own any-hit kernel.
+        glClearNamedBufferData(g_buffer_shadow_counter, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glUseProgram(g_program_shadow);
+        glUniform3fv(glGetUniformLocation(g_program_shadow, "lightPosition"), 1, g_description.light.position);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g_buffer_triangle);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, g_buffer_shadow_counter);
+        glBindImageTexture(
+            0,
+            g_texture_trace,
+            0,
+            GL_TRUE,
+            0,
+            GL_READ_ONLY,
+            GL_RGBA32F);
+        glBindImageTexture(
+            1,
+            g_texture_trace_index,
+            0,
+            GL_TRUE,
+            0,
+            GL_READ_ONLY,
+            GL_R32UI);
+        glBindImageTexture(
+            2,
+            g_texture_shadow,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_R8);
+        m_accelerator->beginPass(g_screen_width, g_screen_height);
+        do
+        {
+            m_accelerator->bind(g_program_shadow);
+            dispatchScreen(g_program_shadow, g_screen_width, g_screen_height);
+        } while (m_accelerator->nextWave());
+    }
+
+    void Screen::passLight()
+    {
+        glUseProgram(g_program_light_point);
+        const auto &material = g_description.material;
+        glUniform3fv(glGetUniformLocation(g_program_light_point, "lightPosition"), 1, g_description.light.position);
+        glUniform3fv(glGetUniformLocation(g_program_light_point, "lightColor"), 1, g_description.light.color);
+        glUniform4f(glGetUniformLocation(g_program_light_point, "material"), material.ambient, material.diffuse, material.specular, material.shininess);
+        glBindImageTexture(
+            0,
+            g_texture_trace,
+            0,
+            GL_TRUE,
+            0,
+            GL_READ_ONLY,
+            GL_RGBA32F);
+        glBindImageTexture(
+            1,
+            g_texture_trace_index,
+            0,
+            GL_TRUE,
+            0,
+            GL_READ_ONLY,
+            GL_R32UI);
+        glBindImageTexture(
+            2,
+            g_texture_screen,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_RGBA32F);
+        glBindImageTexture(
+            3,
+            g_texture_shadow,
+            0,
+            GL_TRUE,
+            0,
+            GL_READ_ONLY,
+            GL_R8);
+        dispatchScreen(g_program_light_point, g_screen_width, g_screen_height);
+    }
+
+    void Screen::passFused()
+    {
+        // Nothing goes through the G-buffer: the kernel reads the camera ray and writes the final color of every pixel.
+        glClearNamedBufferData(g_buffer_shadow_counter, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glUseProgram(g_program_fused);
+        const auto &material = g_description.material;
+        glUniform4fv(glGetUniformLocation(g_program_fused, "meshColor"), 1, material.color);
+        glUniform3fv(glGetUniformLocation(g_program_fused, "lightPosition"), 1, g_description.light.position);
+        glUniform3fv(glGetUniformLocation(g_program_fused, "lightColor"), 1, g_description.light.color);
+        glUniform4f(glGetUniformLocation(g_program_fused, "material"), material.ambient, material.diffuse, material.specular, material.shininess);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g_buffer_vertex);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g_buffer_triangle);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g_buffer_sphere);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, g_buffer_vertex_attribute);
+        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, g_buffer_shadow_counter);
+        glBindImageTexture(
+            0,
+            g_texture_screen,
+            0,
+            GL_TRUE,
+            0,
+            GL_WRITE_ONLY,
+            GL_RGBA32F);
+        m_accelerator->bind(g_program_fused);
+        dispatchScreen(g_program_fused, g_screen_width, g_screen_height);
+    }
+
+    const bvh::Tree &Screen::bvhTree()
+    {
+        if (!g_bvh.nodes.empty())
+        {
+            return g_bvh;
+        }
+        // Triangles and spheres share one tree, so a single traversal dispatch covers the whole scene.
+        // A tree stored with the scene is used when it was made by the configured builder, whatever its parameters.
+        // It bounds the stored positions, which quantization moves.
+        if (!g_scene.bvh.nodes.empty() && g_scene.bvh_spatial == (m_options.bvh_build == BvhBuild::sbvh) && !m_options.quantize)
+        {
+            g_bvh = std::move(g_scene.bvh);
+            fprintf(stderr, "[bvh]: %s, %zu nodes, %zu references, prebuilt\n", g_scene.bvh_spatial ? "sbvh" : "sah", g_bvh.nodes.size(), g_bvh.references.size());
+            return g_bvh;
+        }
+        auto bounds = g_scene.bounds();
+        auto references = g_scene.references();
+        auto start = std::chrono::steady_clock::now();
+        if (m_options.bvh_build == BvhBuild::sbvh)
+        {
+            auto clip = [&](std::size_t index, const bvh::Bounds &box) {
+                return g_scene.clip(index, box);
+            };
+            g_bvh = bvh::buildSpatial(bounds, references, clip, m_options.sbvh_alpha);
+        }
+        else
+        {
+            g_bvh = bvh::build(bounds, references);
+        }
+        auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+        fprintf(stderr, "[bvh]: %s, %zu nodes, %zu references, %.1f ms\n", m_options.bvh_build == BvhBuild::sbvh ? "sbvh" : "sah", g_bvh.nodes.size(), g_bvh.references.size(), duration.count());
+        return g_bvh;
+    }
+
+    std::unique_ptr<accelerator::Accelerator> Screen::createAccelerator(AcceleratorKind kind)
+    {
+        switch (kind)
+        {
+        case AcceleratorKind::grid:
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto grid = grid::build(g_scene.bounds(), g_scene.references(), m_options.grid_density);
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            fprintf(stderr, "[grid]: %dx%dx%d cells, %zu references, %.1f ms\n", grid.resolution[0], grid.resolution[1], grid.resolution[2], grid.references.size(), duration.count());
+            return std::make_unique<accelerator::Grid>(grid);
+        }
+        case AcceleratorKind::brute:
+            return std::make_unique<accelerator::Brute>(g_scene.references());
+        case AcceleratorKind::meshlet:
+        {
+            // Meshlets stored with the scene are used as they are, whatever their size.
+            if (g_scene.meshlets.table.empty())
+            {
+                auto start = std::chrono::steady_clock::now();
+                g_scene.meshlets = scene::buildMeshlets(g_scene, m_options.meshlet_size);
+                auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+                fprintf(stderr, "[meshlets]: %zu meshlets, %zu bytes of indices, was %zu bytes, %.1f ms\n", g_scene.meshlets.table.size(), g_scene.meshlets.table.size_bytes() + g_scene.meshlets.data.size_bytes(), g_scene.triangles.size_bytes(), duration.count());
+            }
+            return std::make_unique<accelerator::Meshlet>(g_scene.meshlets, g_scene.spheres, m_options.traversal, m_options.bvh_order);
+        }
+        case AcceleratorKind::stream:
+        {
+            // Clusters stored with the scene are used as they are, whatever their size.
+            if (g_scene.clusters.table.empty())
+            {
+                auto start = std::chrono::steady_clock::now();
+                g_scene.clusters = scene::buildClusters(g_scene, bvhTree(), m_options.cluster_size);
+                auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+                fprintf(stderr, "[clusters]: %zu clusters, %zu vertices, %zu triangles, %.1f ms\n", g_scene.clusters.table.size(), g_scene.clusters.vertices.size(), g_scene.clusters.triangles.size(), duration.count());
+            }
+            return std::make_unique<accelerator::Stream>(g_scene.clusters, m_options.stream_pool << 20);
+        }
+        default:
+            return std::make_unique<accelerator::Bvh>(bvhTree(), m_options.traversal, m_options.bvh_order);
+        }
+    }
+
+    void Screen::compileKernels()
+    {
+        // Programs of the previous kernel set (if any) are replaced, the accelerator decides which variant is compiled.
+        for (const auto &kernel : m_kernels)
+        {
+            gl::program::destroy(this->*kernel.program);
+        }
+        // Variants are tuned separately: they differ in register pressure and may prefer different tiles.
+        auto variant = m_accelerator->variant();
+        auto defines = m_accelerator->defines();
+        if (m_options.quantize)
+        {
+            variant += ".quantized";
+            defines["VERTEX_QUANTIZED"] = "1";
+        }
+        Kernel primary = {"trace." + variant, m_accelerator->traceKernel(), defines, &Screen::g_program_trace, "primary"};
+        if (m_options.primary == PrimaryRays::raster)
+        {
+            primary = {"resolve." + variant, "var/raytrace/resolve.glsl", defines, &Screen::g_program_resolve, "primary"};
+        }
+        else if (m_options.primary == PrimaryRays::binned)
+        {
+            auto binDefines = defines;
+            binDefines["BIN_SIZE"] = std::to_string(binSize);
+            // Tuned with the binning passes in front of it, which do not depend on the tile.
+            primary = {"binned." + variant, "var/raytrace/bin_trace.glsl", binDefines, &Screen::g_program_bin_trace, "primary"};
+        }
+        if (m_options.pipeline == Pipeline::fused)
+        {
+            m_kernels = {
+                {"fused." + variant, m_accelerator->fusedKernel(), defines, &Screen::g_program_fused, "fused"},
+            };
+        }
+        else
+        {
+            m_kernels = {
+                primary,
+                {"shadow." + variant, m_accelerator->shadowKernel(), defines, &Screen::g_program_shadow, "shadow"},
+                {"light", "var/raytrace/light.glsl", {}, &Screen::g_program_light_point, "light"},
+            };
+        }
+        if (m_options.primary == PrimaryRays::raster)
+        {
+            // Recompiled with the kernels: vertex pulling decodes the same layout.
+            gl::program::destroy(g_program_visibility_triangle);
+            gl::program::destroy(g_program_visibility_sphere);
+            auto shader = [&](GLenum type, const char *filename) {
+                return gl::shader::fromFile(type, std::filesystem::resolve(filename, projectDir).c_str(), defines);
+            };
+            g_program_visibility_triangle = gl::program::create(
+                shader(GL_VERTEX_SHADER, "var/visibility/triangle_vertex.glsl"),
+                shader(GL_FRAGMENT_SHADER, "var/visibility/triangle_fragment.glsl"));
+            g_program_visibility_sphere = gl::program::create(
+                shader(GL_VERTEX_SHADER, "var/visibility/sphere_vertex.glsl"),
+                shader(GL_FRAGMENT_SHADER, "var/visibility/sphere_fragment.glsl"));
+        }
+        if (m_options.primary == PrimaryRays::binned && g_program_bin_scan == 0)
+        {
+            // Not per-pixel, so not tuned; only the vertex layout matters, which is fixed at launch.
+            gl::shader::define_map binDefines = {{"BIN_SIZE", std::to_string(binSize)}};
+            if (m_options.quantize)
+            {
+                binDefines["VERTEX_QUANTIZED"] = "1";
+            }
+            auto program = [&](const char *filename, const gl::shader::define_map &defines) {
+                return gl::program::create(gl::shader::fromFile(GL_COMPUTE_SHADER, std::filesystem::resolve(filename, projectDir).c_str(), defines));
+            };
+            g_program_bin_scan = program("var/raytrace/bin_scan.glsl", binDefines);
+            g_program_bin_count = program("var/raytrace/bin_build.glsl", binDefines);
+            binDefines["BIN_FILL"] = "1";
+            g_program_bin_fill = program("var/raytrace/bin_build.glsl", binDefines);
+        }
+        // Kernels tuned by an earlier launch on this renderer are compiled with the winner directly.
+        tuner::Cache cache(tuner::defaultCachePath());
+        for (const auto &kernel : m_kernels)
+        {
+            auto localSize = cache.find(kernel.name);
+            m_need_tune = m_need_tune || !localSize;
+            this->*kernel.program = createComputeProgram(kernel.filename, localSize.value_or(defaultLocalSize), kernel.defines);
+        }
+        // Before the first resize, the screen has no size for the transient textures yet.
+        if (!m_need_resize)
+        {
+            buildGraph();
+        }
+    }
+
+    void Screen::benchmark(unsigned frames)
+    {
+        // The first frame initializes the scene, sizes the textures and tunes the kernels of the configured accelerator.
+        update();
+        auto configured = std::move(m_accelerator);
+        auto configuredPipeline = m_options.pipeline;
+        std::vector<std::function<std::unique_ptr<accelerator::Accelerator>()>> candidates;
+        if (!m_resident)
+        {
+            candidates = {[this]() { return createAccelerator(m_kind); }};
+        }
+        else
+        {
+            candidates = {
+                [this]() { return std::make_unique<accelerator::Bvh>(bvhTree(), Traversal::stack, bvh::Order::depth_first); },
+                [this]() { return std::make_unique<accelerator::Bvh>(bvhTree(), Traversal::stack, bvh::Order::van_emde_boas); },
+                [this]() { return std::make_unique<accelerator::Bvh>(bvhTree(), Traversal::stack, bvh::Order::treelet); },
+                [this]() { return std::make_unique<accelerator::Bvh>(bvhTree(), Traversal::stackless, bvh::Order::depth_first); },
+                [this]() { return createAccelerator(AcceleratorKind::grid); },
+            };
+            // Visibility ids are scene triangles, which meshlet kernels do not index.
+            if (m_options.primary == PrimaryRays::trace)
+            {
+                candidates.emplace_back([this]() { return createAccelerator(AcceleratorKind::meshlet); });
+            }
+        }
+        // Beyond this, a frame of brute force takes long enough to make the benchmark useless.
+        if (m_resident && g_scene.primitiveCount() <= benchmarkBruteForceLimit)
+        {
+            candidates.emplace_back([this]() { return createAccelerator(AcceleratorKind::brute); });
+        }
+        for (const auto &candidate : candidates)
+        {
+            m_accelerator.reset();
+            m_accelerator = candidate();
+            // Both pipelines run on the same accelerator, so the difference is the G-buffer round trip.
+            std::vector<Pipeline> pipelines = {Pipeline::deferred};
+            if (m_options.primary == PrimaryRays::trace && m_accelerator->fusedKernel() != nullptr)
+            {
+                pipelines.push_back(Pipeline::fused);
+            }
+            for (auto pipeline : pipelines)
+            {
+                m_options.pipeline = pipeline;
+                compileKernels();
+                if (m_need_tune)
+                {
+                    tune();
+                    m_need_tune = false;
+                }
+                GLuint64 traceTime = 0, shadowTime = 0, frameTime = 0, shadowRays = 0;
+                for (unsigned frame = 0; frame < frames; ++frame)
+                {
+                    glQueryCounter(g_query_frame[0], GL_TIMESTAMP);
+                    if (pipeline == Pipeline::fused)
+                    {
+                        m_graph.execute();
+                    }
+                    else
+                    {
+                        glBeginQuery(GL_TIME_ELAPSED, g_query_pass[0]);
+                        m_graph.execute("primary");
+                        glEndQuery(GL_TIME_ELAPSED);
+                        glBeginQuery(GL_TIME_ELAPSED, g_query_pass[1]);
+                        m_graph.execute("shadow");
+                        glEndQuery(GL_TIME_ELAPSED);
+                        m_graph.execute("light");
+                    }
+                    glQueryCounter(g_query_frame[1], GL_TIMESTAMP);
+                    GLuint64 time_elapsed;
+                    if (pipeline == Pipeline::deferred)
+                    {
+                        glGetQueryObjectui64v(g_query_pass[0], GL_QUERY_RESULT, &time_elapsed);
+                        traceTime += time_elapsed;
+                        glGetQueryObjectui64v(g_query_pass[1], GL_QUERY_RESULT, &time_elapsed);
+                        shadowTime += time_elapsed;
+                    }
+                    GLuint64 frameStart, frameEnd;
+                    glGetQueryObjectui64v(g_query_frame[0], GL_QUERY_RESULT, &frameStart);
+                    glGetQueryObjectui64v(g_query_frame[1], GL_QUERY_RESULT, &frameEnd);
+                    frameTime += frameEnd - frameStart;
+                    GLuint shadow_rays;
+                    m_graph.use({graph::read(m_graph_shadow_counter, graph::Access::transfer)});
+                    glGetNamedBufferSubData(g_buffer_shadow_counter, 0, sizeof(shadow_rays), &shadow_rays);
+                    shadowRays += shadow_rays;
+                }
+                auto primaryRays = GLuint64(g_screen_width) * GLuint64(g_screen_height) * frames;
+                if (pipeline == Pipeline::deferred)
+                {
+                    // The stack size is what the kernel declares, not a measurement of the driver's allocation.
+                    auto stackBytes = m_accelerator->stackSize();
+                    fprintf(
+                        stderr,
+                        "[benchmark][%s][%d][%d]: trace %.3f ms/frame %.2f Mrays/s, shadow %.3f ms/frame %.2f Mrays/s, static stack %zu bytes/invocation\n",
+                        m_accelerator->name().c_str(),
+                        g_screen_width,
+                        g_screen_height,
+                        double(traceTime) * 1e-6 / frames,
+                        traceTime > 0 ? double(primaryRays) * 1e3 / double(traceTime) : 0.0,
+                        double(shadowTime) * 1e-6 / frames,
+                        shadowTime > 0 ? double(shadowRays) * 1e3 / double(shadowTime) : 0.0,
+                        stackBytes);
+                }
+                // Whole frames, from the camera rays to the final color, for both pipelines alike.
+                fprintf(
+                    stderr,
+                    "[benchmark][%s][%s][%d][%d]: frame %.3f ms/frame %.2f Mrays/s\n",
+                    m_accelerator->name().c_str(),
+                    pipeline == Pipeline::fused ? "fused" : "deferred",
+                    g_screen_width,
+                    g_screen_height,
+                    double(frameTime) * 1e-6 / frames,
+                    frameTime > 0 ? double(primaryRays + shadowRays) * 1e3 / double(frameTime) : 0.0);
+            }
+        }
+        m_options.pipeline = configuredPipeline;
+        m_accelerator = std::move(configured);
+        compileKernels();
+    }
+
+    void Screen::tune()
+    {
+        tuner::Cache cache(tuner::defaultCachePath());
+        GLint maxInvocations;
+        glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations);
+        // Kernels are tuned in frame order, so the winner of each one produces real input (hits) for the next.
+        for (const auto &kernel : m_kernels)
+        {
+            if (cache.find(kernel.name))
+            {
+                m_graph.execute(kernel.pass);
+                continue;
+            }
+            gl::program::destroy(this->*kernel.program);
+            GLuint bestProgram = 0;
+            GLuint64 bestTime = 0;
+            tuner::local_size bestSize = defaultLocalSize;
+            for (const auto &candidate : tuner::candidates)
+            {
+                if (GLint(candidate[0] * candidate[1]) > maxInvocations)
+                {
+                    continue;
+                }
+                GLuint program;
+                try
+                {
+                    program = createComputeProgram(kernel.filename, candidate, kernel.defines);
+                }
+                catch (const gl::program::link_error &)
+                {
+                    // Too many resources for this local size on this device.
+                    continue;
+                }
+                this->*kernel.program = program;
+                m_graph.execute(kernel.pass);
+                glBeginQuery(GL_TIME_ELAPSED, g_query_time_measure);
+                for (int i = 0; i < tuneRepeat; ++i)
+                {
+                    m_graph.execute(kernel.pass);
+                }
+                glEndQuery(GL_TIME_ELAPSED);
+                GLuint64 time_elapsed;
+                glGetQueryObjectui64v(g_query_time_measure, GL_QUERY_RESULT, &time_elapsed);
+                if (bestProgram == 0 || time_elapsed < bestTime)
+                {
+                    gl::program::destroy(bestProgram);
+                    bestProgram = program;
+                    bestTime = time_elapsed;
+                    bestSize = candidate;
+                }
+                else
+                {
+                    gl::program::destroy(program);
+                }
+            }
+            if (bestProgram == 0)
+            {
+                // Nothing was measured: run the default untested and leave the kernel to be tuned on the next launch.
+                fprintf(stderr, "[tuner][%s][%d][%d]: no candidate could be measured, using %ux%u untested\n", kernel.name.c_str(), g_screen_width, g_screen_height, defaultLocalSize[0], defaultLocalSize[1]);
+                this->*kernel.program = createComputeProgram(kernel.filename, defaultLocalSize, kernel.defines);
+                m_graph.execute(kernel.pass);
+                continue;
+            }
+            this->*kernel.program = bestProgram;
+            m_graph.execute(kernel.pass);
+            cache.store(kernel.name, bestSize);
+            fprintf(stderr, "[tuner][%s][%d][%d]: %ux%u %lu ns\n", kernel.name.c_str(), g_screen_width, g_screen_height, bestSize[0], bestSize[1], bestTime / tuneRepeat);
+        }
+        cache.save();
+    }
+
     Screen::~Screen() = default;
 }
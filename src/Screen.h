@@ -4,50 +4,105 @@
 #include <array>
 #include <map>
 #include <memory>
+#include <string>
 #include <vector>
 #include <SDL2/SDL.h>
 #include <GL/gl.h>
-
-typedef struct {
-    GLfloat location[3];
-    GLfloat normal[3];
-    GLfloat uv[2];
-} Vertex;
+#include "accelerator/accelerator.h"
+#include "bvh/bvh.h"
+#include "gl/shader.h"
+#include "graph.h"
+#include "options.h"
+#include "scene/description.h"
+#include "scene/scene.h"
 
 namespace dragiyski::raytrace {
     class Screen {
     private:
         SDL_Window *m_window;
         SDL_GLContext m_context;
+        Options m_options;
         bool m_is_initialized;
         bool m_need_resize;
+        bool m_need_tune;
         GLuint g_buffer_vertex_screen, g_buffer_index_screen, g_array_screen, g_program_present, g_texture_screen;
-        GLuint g_program_clear, g_program_screen, g_texture_ray, g_texture_trace, g_texture_trace_index;
-        GLuint g_program_raytrace_triangle;
+        // The G-buffer, the shadow image and the visibility buffer are transient textures of the frame graph.
+        GLuint g_texture_trace = 0, g_texture_trace_index = 0;
+        // Uniform block of var/raytrace/camera.glsl, from which the kernels generate their camera rays.
+        GLuint g_buffer_camera;
+        GLuint g_program_trace;
+        // Visibility buffer of --primary raster: primitive ids and their depth, resolved into the G-buffer.
+        GLuint g_program_resolve = 0, g_program_visibility_triangle = 0, g_program_visibility_sphere = 0, g_array_visibility = 0;
+        GLuint g_framebuffer_visibility, g_texture_visibility = 0, g_renderbuffer_visibility_depth;
+        // Screen tiles of --primary binned, with the lists of the primitives that may be visible in each.
+        GLuint g_program_bin_count = 0, g_program_bin_scan = 0, g_program_bin_fill = 0, g_program_bin_trace = 0;
+        GLuint g_buffer_bin = 0, g_buffer_bin_reference = 0;
+        // References the list buffer holds.
+        GLuint m_bin_capacity = 0;
         GLuint g_program_light_point;
-        GLuint g_query_time_measure;
-        GLuint g_debth_buffer;
-        GLuint g_stencil_buffer;
+        // Primary ray, shadow ray and lighting in one kernel, with --pipeline fused.
+        GLuint g_program_fused = 0;
+        GLuint g_program_shadow, g_texture_shadow = 0;
+        GLuint g_buffer_vertex, g_buffer_vertex_attribute, g_buffer_triangle, g_buffer_sphere, g_buffer_shadow_counter;
+        GLuint g_query_time_measure, g_query_pass[2], g_query_frame[2];
+        GLuint g_debth_buffer = 0;
         GLsizei g_screen_width, g_screen_height;
-        std::vector<Vertex> g_cube_vertices;
-        std::vector<std::array<GLuint, 3>> g_cube_triangles;
+        scene::Description g_description;
+        scene::Scene g_scene;
+        bvh::Tree g_bvh;
+        // Whether the scene triangles are on the GPU; without them, only the configured accelerator (streamed clusters or
+        // meshlets) can trace.
+        bool m_resident = true;
+        AcceleratorKind m_kind = AcceleratorKind::bvh;
+        std::unique_ptr<accelerator::Accelerator> m_accelerator;
+        // Passes of a frame for the current kernels and screen size, and the resources read outside of them.
+        graph::Graph m_graph;
+        graph::resource_id m_graph_screen = 0, m_graph_shadow_counter = 0;
         static std::map<uint32_t, std::shared_ptr<Screen>> window_screen_map;
     private:
-        explicit Screen(SDL_Window *, SDL_GLContext);
+        /**
+         * A per-pixel compute kernel: its cache key, source, variant defines and the group of frame graph passes that
+         * binds its resources and dispatches it.
+         */
+        struct Kernel {
+            std::string name;
+            const char *filename;
+            gl::shader::define_map defines;
+            GLuint Screen::*program;
+            std::string pass;
+        };
+        std::vector<Kernel> m_kernels;
+    private:
+        explicit Screen(SDL_Window *, SDL_GLContext, const Options &);
     public:
         virtual ~Screen();
     public:
-        static std::shared_ptr<Screen> New(const char *title);
+        static std::shared_ptr<Screen> New(const char *title, const Options &options);
         static void notify(const SDL_Event &);
     private:
         void notifyWindow(const SDL_Event &);
     public:
         void update();
+        void benchmark(unsigned frames);
     protected:
         void initialize();
         void resize();
         void paint();
         void release();
+        const bvh::Tree &bvhTree();
+        std::unique_ptr<accelerator::Accelerator> createAccelerator(AcceleratorKind kind);
+        void compileKernels();
+        void tune();
+        void updateCamera();
+        void buildGraph();
+        void passTrace();
+        void passRaster();
+        void passResolve();
+        void passBinList(GLuint program);
+        void passBinTrace();
+        void passShadow();
+        void passLight();
+        void passFused();
     };
 }
 
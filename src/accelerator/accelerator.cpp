@@ -0,0 +1,398 @@
+#include "accelerator.h"
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <stdexcept>
+#include "gl/buffer.h"
+
+namespace dragiyski::raytrace::accelerator {
+    const char *Accelerator::traceKernel() const {
+        return "var/raytrace/trace.glsl";
+    }
+
+    const char *Accelerator::shadowKernel() const {
+        return "var/raytrace/shadow.glsl";
+    }
+
+    const char *Accelerator::fusedKernel() const {
+        return "var/raytrace/fused.glsl";
+    }
+
+    std::size_t Accelerator::stackSize() const {
+        return 0;
+    }
+
+    void Accelerator::beginPass(GLsizei, GLsizei) {
+    }
+
+    bool Accelerator::nextWave() {
+        return false;
+    }
+
+    Bvh::Bvh(const bvh::Tree &tree, Traversal traversal, bvh::Order order) : m_traversal(traversal), m_order(order) {
+        // The stackless layout is depth first by construction, the order only applies to the stack traversal.
+        g_buffer_node = gl::buffer::createStorage(traversal == Traversal::stackless ? bvh::thread(tree) : bvh::reorder(tree, order).nodes);
+        g_buffer_reference = gl::buffer::createStorage(tree.references);
+    }
+
+    Bvh::~Bvh() {
+        glDeleteBuffers(1, &g_buffer_node);
+        glDeleteBuffers(1, &g_buffer_reference);
+    }
+
+    std::string Bvh::name() const {
+        if (m_traversal == Traversal::stackless) {
+            return "bvh.stackless";
+        }
+        switch (m_order) {
+            case bvh::Order::van_emde_boas:
+                return "bvh.veb";
+            case bvh::Order::treelet:
+                return "bvh.treelet";
+            default:
+                return "bvh.dfs";
+        }
+    }
+
+    std::string Bvh::variant() const {
+        return m_traversal == Traversal::stackless ? "bvh.stackless" : "bvh";
+    }
+
+    gl::shader::define_map Bvh::defines() const {
+        if (m_traversal == Traversal::stackless) {
+            return {{"BVH_STACKLESS", "1"}};
+        }
+        return {};
+    }
+
+    std::size_t Bvh::stackSize() const {
+        return m_traversal == Traversal::stack ? bvh::max_depth * sizeof(GLuint) : 0;
+    }
+
+    void Bvh::bind(GLuint) const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, g_buffer_node);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, g_buffer_reference);
+    }
+
+    Grid::Grid(const grid::Grid &grid) {
+        std::copy(std::begin(grid.min), std::end(grid.min), std::begin(m_min));
+        std::copy(std::begin(grid.cell_size), std::end(grid.cell_size), std::begin(m_cell_size));
+        std::copy(std::begin(grid.resolution), std::end(grid.resolution), std::begin(m_resolution));
+        g_buffer_cell = gl::buffer::createStorage(grid.cells);
+        g_buffer_reference = gl::buffer::createStorage(grid.references);
+    }
+
+    Grid::~Grid() {
+        glDeleteBuffers(1, &g_buffer_cell);
+        glDeleteBuffers(1, &g_buffer_reference);
+    }
+
+    std::string Grid::name() const {
+        return "grid";
+    }
+
+    std::string Grid::variant() const {
+        return "grid";
+    }
+
+    gl::shader::define_map Grid::defines() const {
+        return {{"ACCELERATOR_GRID", "1"}};
+    }
+
+    void Grid::bind(GLuint program) const {
+        glUniform3fv(glGetUniformLocation(program, "gridMin"), 1, m_min);
+        glUniform3fv(glGetUniformLocation(program, "gridCellSize"), 1, m_cell_size);
+        glUniform3iv(glGetUniformLocation(program, "gridResolution"), 1, m_resolution);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, g_buffer_cell);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, g_buffer_reference);
+    }
+
+    Brute::Brute(const std::vector<GLuint> &references) : m_reference_count(static_cast<GLuint>(references.size())) {
+        g_buffer_reference = gl::buffer::createStorage(references);
+    }
+
+    Brute::~Brute() {
+        glDeleteBuffers(1, &g_buffer_reference);
+    }
+
+    std::string Brute::name() const {
+        return "brute";
+    }
+
+    std::string Brute::variant() const {
+        return "brute";
+    }
+
+    gl::shader::define_map Brute::defines() const {
+        return {{"ACCELERATOR_LINEAR", "1"}};
+    }
+
+    const char *Brute::traceKernel() const {
+        return "var/raytrace/brute.glsl";
+    }
+
+    void Brute::bind(GLuint program) const {
+        glUniform1ui(glGetUniformLocation(program, "referenceCount"), m_reference_count);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, g_buffer_reference);
+    }
+
+    namespace {
+        // Meshlets and spheres in one tree, numbered like the scene: a reference is a meshlet or, with
+        // bvh::reference_sphere, a sphere.
+        bvh::Tree buildMeshletTree(const scene::Meshlets &meshlets, std::span<const Sphere> spheres) {
+            std::vector<bvh::Bounds> bounds;
+            std::vector<GLuint> references;
+            for (const auto &meshlet : meshlets.table) {
+                bvh::Bounds box{};
+                std::copy(std::begin(meshlet.min), std::end(meshlet.min), box.min);
+                std::copy(std::begin(meshlet.max), std::end(meshlet.max), box.max);
+                references.push_back(static_cast<GLuint>(bounds.size()));
+                bounds.push_back(box);
+            }
+            for (std::size_t index = 0; index < spheres.size(); ++index) {
+                const auto &sphere = spheres[index];
+                references.push_back(static_cast<GLuint>(index) | bvh::reference_sphere);
+                bounds.push_back({
+                    {sphere.center[0] - sphere.radius, sphere.center[1] - sphere.radius, sphere.center[2] - sphere.radius},
+                    {sphere.center[0] + sphere.radius, sphere.center[1] + sphere.radius, sphere.center[2] + sphere.radius},
+                });
+            }
+            return bvh::build(bounds, references);
+        }
+    }
+
+    Meshlet::Meshlet(const scene::Meshlets &meshlets, std::span<const Sphere> spheres, Traversal traversal, bvh::Order order) :
+        m_bvh(buildMeshletTree(meshlets, spheres), traversal, order) {
+        g_buffer_meshlet = gl::buffer::createStorage(meshlets.table);
+        g_buffer_meshlet_data = gl::buffer::createStorage(meshlets.data);
+    }
+
+    Meshlet::~Meshlet() {
+        glDeleteBuffers(1, &g_buffer_meshlet);
+        glDeleteBuffers(1, &g_buffer_meshlet_data);
+    }
+
+    std::string Meshlet::name() const {
+        // bvh.dfs becomes meshlet.dfs, and so on.
+        return "meshlet" + m_bvh.name().substr(3);
+    }
+
+    std::string Meshlet::variant() const {
+        return "meshlet" + m_bvh.variant().substr(3);
+    }
+
+    gl::shader::define_map Meshlet::defines() const {
+        auto defines = m_bvh.defines();
+        defines["ACCELERATOR_MESHLET"] = "1";
+        return defines;
+    }
+
+    std::size_t Meshlet::stackSize() const {
+        return m_bvh.stackSize();
+    }
+
+    void Meshlet::bind(GLuint program) const {
+        m_bvh.bind(program);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, g_buffer_meshlet);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, g_buffer_meshlet_data);
+    }
+
+    Stream::Stream(const scene::Clusters &clusters, std::size_t pool_size) : m_clusters(clusters) {
+        // The clusters are numbered in the order of the leaves of the tree over them, so a leaf is a range of the table.
+        std::vector<bvh::Bounds> bounds;
+        std::vector<GLuint> references(clusters.table.size());
+        std::iota(references.begin(), references.end(), 0);
+        for (const auto &cluster : clusters.table) {
+            bvh::Bounds box{};
+            std::copy(std::begin(cluster.min), std::end(cluster.min), box.min);
+            std::copy(std::begin(cluster.max), std::end(cluster.max), box.max);
+            bounds.push_back(box);
+        }
+        auto top = bvh::build(bounds, references);
+        m_order = std::move(top.references);
+
+        // Every slot fits the largest cluster.
+        GLuint nodes = 0, references_per_slot = 0, triangles = 0, vertices = 0;
+        for (const auto &cluster : clusters.table) {
+            nodes = std::max(nodes, cluster.node_count);
+            references_per_slot = std::max(references_per_slot, cluster.reference_count);
+            triangles = std::max(triangles, cluster.triangle_count);
+            vertices = std::max(vertices, cluster.vertex_count);
+        }
+        m_slot_layout[1] = slot_header + nodes * GLuint(sizeof(bvh::Node) / sizeof(GLuint));
+        m_slot_layout[2] = m_slot_layout[1] + references_per_slot;
+        m_slot_layout[3] = m_slot_layout[2] + triangles * 3;
+        m_slot_attributes = m_slot_layout[3] + vertices * GLuint(sizeof(scene::Position) / sizeof(GLuint));
+        m_slot_layout[0] = m_slot_attributes + vertices * GLuint(sizeof(scene::Attributes) / sizeof(GLuint));
+        GLint64 maxBlockSize;
+        glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+        auto slotSize = std::size_t(m_slot_layout[0]) * sizeof(GLuint);
+        auto slots = std::clamp<std::size_t>(std::min<std::size_t>(pool_size, maxBlockSize) / slotSize, 1, std::max<std::size_t>(m_order.size(), 1));
+        m_slot_cluster.assign(slots, not_resident);
+        m_last_use.assign(m_order.size(), 0);
+
+        for (auto index : m_order) {
+            const auto &cluster = clusters.table[index];
+            Entry entry{};
+            std::copy(std::begin(cluster.min), std::end(cluster.min), entry.min);
+            std::copy(std::begin(cluster.max), std::end(cluster.max), entry.max);
+            entry.slot = not_resident;
+            m_table.push_back(entry);
+        }
+        g_buffer_cluster = gl::buffer::createStorage(m_table, GL_DYNAMIC_STORAGE_BIT);
+        g_buffer_top = gl::buffer::createStorage(top.nodes);
+        glCreateBuffers(1, &g_buffer_pool);
+        glNamedBufferStorage(g_buffer_pool, GLsizeiptr(slots * slotSize), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glCreateBuffers(1, &g_buffer_pending);
+        glNamedBufferStorage(g_buffer_pending, sizeof(GLuint), nullptr, 0);
+        g_buffer_ray = 0;
+        fprintf(stderr, "[stream]: %zu clusters, %zu slots of %zu bytes\n", m_order.size(), slots, slotSize);
+    }
+
+    Stream::~Stream() {
+        glDeleteBuffers(1, &g_buffer_cluster);
+        glDeleteBuffers(1, &g_buffer_top);
+        glDeleteBuffers(1, &g_buffer_pool);
+        glDeleteBuffers(1, &g_buffer_ray);
+        glDeleteBuffers(1, &g_buffer_pending);
+    }
+
+    std::string Stream::name() const {
+        return "stream";
+    }
+
+    std::string Stream::variant() const {
+        return "stream";
+    }
+
+    gl::shader::define_map Stream::defines() const {
+        return {};
+    }
+
+    const char *Stream::traceKernel() const {
+        return "var/raytrace/stream_trace.glsl";
+    }
+
+    const char *Stream::shadowKernel() const {
+        return "var/raytrace/stream_shadow.glsl";
+    }
+
+    const char *Stream::fusedKernel() const {
+        // A primary ray may wait for clusters, and its shadow ray could only start in a later wave.
+        return nullptr;
+    }
+
+    std::size_t Stream::stackSize() const {
+        // The stacks of the two trees are never live at the same time.
+        return bvh::max_depth * sizeof(GLuint);
+    }
+
+    void Stream::bind(GLuint program) const {
+        glUniform4uiv(glGetUniformLocation(program, "slotLayout"), 1, m_slot_layout);
+        glUniform1ui(glGetUniformLocation(program, "slotAttributes"), m_slot_attributes);
+        glUniform1ui(glGetUniformLocation(program, "wave"), m_wave);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, g_buffer_cluster);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, g_buffer_top);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, g_buffer_pool);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, g_buffer_ray);
+        glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 1, g_buffer_pending);
+    }
+
+    void Stream::beginPass(GLsizei width, GLsizei height) {
+        if (width != m_width || height != m_height || g_buffer_ray == 0) {
+            // Wave 0 initializes every ray, so the contents do not matter.
+            glDeleteBuffers(1, &g_buffer_ray);
+            glCreateBuffers(1, &g_buffer_ray);
+            glNamedBufferStorage(g_buffer_ray, std::max<GLsizeiptr>(GLsizeiptr(width) * height, 1) * ray_size, nullptr, 0);
+            m_width = width;
+            m_height = height;
+        }
+        glClearNamedBufferData(g_buffer_pending, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        m_wave = 0;
+        m_loaded_clusters = 0;
+        m_loaded_bytes = 0;
+    }
+
+    bool Stream::nextWave() {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        GLuint pending;
+        glGetNamedBufferSubData(g_buffer_pending, 0, sizeof(pending), &pending);
+        if (pending == 0) {
+            if (m_loaded_clusters > 0) {
+                fprintf(stderr, "[stream][%d][%d]: %u waves, %zu clusters loaded, %zu bytes\n", m_width, m_height, m_wave + 1, m_loaded_clusters, m_loaded_bytes);
+            }
+            return false;
+        }
+
+        // Requests accumulate until a wave has to load: a pass that finds everything resident costs no read back, and
+        // the marks of the passes since the last load all count as recent.
+        glGetNamedBufferSubData(g_buffer_cluster, 0, GLsizeiptr(m_table.size() * sizeof(Entry)), m_table.data());
+        ++m_clock;
+        std::vector<GLuint> requested;
+        for (GLuint cluster = 0; cluster < m_table.size(); ++cluster) {
+            if (m_table[cluster].request == request_used) {
+                m_last_use[cluster] = m_clock;
+            } else if (m_table[cluster].request == request_load) {
+                requested.push_back(cluster);
+            }
+            m_table[cluster].request = 0;
+        }
+
+        // Empty slots first, then the least recently used. Clusters loaded now get the current stamp, so a wave never
+        // evicts what it loads.
+        std::vector<GLuint> slots(m_slot_cluster.size());
+        std::iota(slots.begin(), slots.end(), 0);
+        auto age = [this](GLuint slot) {
+            return m_slot_cluster[slot] == not_resident ? 0 : m_last_use[m_slot_cluster[slot]] + 1;
+        };
+        std::stable_sort(slots.begin(), slots.end(), [&](GLuint a, GLuint b) {
+            return age(a) < age(b);
+        });
+        if (requested.empty()) {
+            throw std::runtime_error("Stream: rays are waiting, but no cluster was requested");
+        }
+        requested.resize(std::min(requested.size(), slots.size()));
+        for (std::size_t index = 0; index < requested.size(); ++index) {
+            auto slot = slots[index];
+            if (m_slot_cluster[slot] != not_resident) {
+                m_table[m_slot_cluster[slot]].slot = not_resident;
+            }
+            load(requested[index], slot);
+        }
+        glNamedBufferSubData(g_buffer_cluster, 0, GLsizeiptr(m_table.size() * sizeof(Entry)), m_table.data());
+        glClearNamedBufferData(g_buffer_pending, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+        ++m_wave;
+        return true;
+    }
+
+    void Stream::load(GLuint cluster, GLuint slot) {
+        const auto &source = m_clusters.table[m_order[cluster]];
+        auto base = GLintptr(slot) * m_slot_layout[0] * GLintptr(sizeof(GLuint));
+        auto upload = [&](GLuint word, const auto &data) {
+            glNamedBufferSubData(g_buffer_pool, base + GLintptr(word) * GLintptr(sizeof(GLuint)), GLsizeiptr(data.size_bytes()), data.data());
+            m_loaded_bytes += data.size_bytes();
+        };
+        GLuint header[slot_header] = {source.triangle_offset};
+        upload(0, std::span<const GLuint>(header));
+        upload(slot_header, m_clusters.nodes.subspan(source.node_offset, source.node_count));
+        upload(m_slot_layout[1], m_clusters.references.subspan(source.reference_offset, source.reference_count));
+        upload(m_slot_layout[2], m_clusters.triangles.subspan(source.triangle_offset, source.triangle_count));
+        // Clusters store whole vertices; the slot has the two streams of scene.glsl.
+        m_positions.clear();
+        m_attributes.clear();
+        for (const auto &vertex : m_clusters.vertices.subspan(source.vertex_offset, source.vertex_count)) {
+            auto &position = m_positions.emplace_back();
+            std::copy(std::begin(vertex.location), std::end(vertex.location), position.begin());
+            auto &attributes = m_attributes.emplace_back();
+            std::copy(std::begin(vertex.normal), std::end(vertex.normal), attributes.normal);
+            std::copy(std::begin(vertex.uv), std::end(vertex.uv), attributes.uv);
+        }
+        upload(m_slot_layout[3], std::span<const scene::Position>(m_positions));
+        upload(m_slot_attributes, std::span<const scene::Attributes>(m_attributes));
+        m_table[cluster].slot = slot;
+        m_slot_cluster[slot] = cluster;
+        m_last_use[cluster] = m_clock;
+        ++m_loaded_clusters;
+    }
+}
@@ -0,0 +1,214 @@
+#ifndef RAYTRACE_ACCELERATOR_H
+#define RAYTRACE_ACCELERATOR_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <GL/gl.h>
+#include "bvh/bvh.h"
+#include "grid/grid.h"
+#include "gl/shader.h"
+#include "options.h"
+#include "scene/scene.h"
+
+namespace dragiyski::raytrace::accelerator {
+    /**
+     * Acceleration structure on the GPU, as seen by the tracing kernels (see var/raytrace/accelerator.glsl).
+     * Implementations own their buffers.
+     */
+    class Accelerator {
+    public:
+        virtual ~Accelerator() = default;
+    public:
+        /**
+         * Name of the configuration, for logs and benchmarks.
+         */
+        [[nodiscard]] virtual std::string name() const = 0;
+
+        /**
+         * Name of the shader variant: configurations with the same variant share compiled (and tuned) kernels.
+         */
+        [[nodiscard]] virtual std::string variant() const = 0;
+
+        /**
+         * Defines selecting the implementation of traceClosest/traceAny.
+         */
+        [[nodiscard]] virtual gl::shader::define_map defines() const = 0;
+
+        /**
+         * Source of the closest hit (primary ray) kernel.
+         */
+        [[nodiscard]] virtual const char *traceKernel() const;
+
+        /**
+         * Source of the any hit (shadow ray) kernel.
+         */
+        [[nodiscard]] virtual const char *shadowKernel() const;
+
+        /**
+         * Source of the kernel that traces, shadows and shades a camera ray at once, or nullptr when the structure
+         * cannot answer both queries in one dispatch.
+         */
+        [[nodiscard]] virtual const char *fusedKernel() const;
+
+        /**
+         * Bytes of traversal stack each invocation declares, as compiled into the kernel.
+         */
+        [[nodiscard]] virtual std::size_t stackSize() const;
+
+        /**
+         * Binds the buffers at bindings 3 (structure) and 4 (references) and sets the uniforms of `program`, which must
+         * be in use.
+         */
+        virtual void bind(GLuint program) const = 0;
+
+        /**
+         * Called before the first dispatch of a pass over `width` x `height` rays.
+         */
+        virtual void beginPass(GLsizei width, GLsizei height);
+
+        /**
+         * Called after every dispatch of a pass: whether rays are waiting for data that is now on the GPU, so the kernel
+         * has to be bound and dispatched again (another wave). Structures that are entirely resident finish in one.
+         */
+        virtual bool nextWave();
+    };
+
+    class Bvh final : public Accelerator {
+    private:
+        Traversal m_traversal;
+        bvh::Order m_order;
+        GLuint g_buffer_node, g_buffer_reference;
+    public:
+        Bvh(const bvh::Tree &tree, Traversal traversal, bvh::Order order);
+        ~Bvh() override;
+    public:
+        [[nodiscard]] std::string name() const override;
+        [[nodiscard]] std::string variant() const override;
+        [[nodiscard]] gl::shader::define_map defines() const override;
+        [[nodiscard]] std::size_t stackSize() const override;
+        void bind(GLuint program) const override;
+    };
+
+    class Grid final : public Accelerator {
+    private:
+        GLfloat m_min[3], m_cell_size[3];
+        GLint m_resolution[3];
+        GLuint g_buffer_cell, g_buffer_reference;
+    public:
+        explicit Grid(const grid::Grid &grid);
+        ~Grid() override;
+    public:
+        [[nodiscard]] std::string name() const override;
+        [[nodiscard]] std::string variant() const override;
+        [[nodiscard]] gl::shader::define_map defines() const override;
+        void bind(GLuint program) const override;
+    };
+
+    /**
+     * No structure: primary rays go through the shared-memory batches of var/raytrace/brute.glsl, other queries test
+     * every reference.
+     */
+    class Brute final : public Accelerator {
+    private:
+        GLuint g_buffer_reference;
+        GLuint m_reference_count;
+    public:
+        explicit Brute(const std::vector<GLuint> &references);
+        ~Brute() override;
+    public:
+        [[nodiscard]] std::string name() const override;
+        [[nodiscard]] std::string variant() const override;
+        [[nodiscard]] gl::shader::define_map defines() const override;
+        [[nodiscard]] const char *traceKernel() const override;
+        void bind(GLuint program) const override;
+    };
+
+    /**
+     * BVH whose leaves reference meshlets (see scene/meshlet.h) and spheres instead of single primitives: a leaf tests the
+     * bounds of each meshlet, then its triangles. The triangles of the scene are not needed on the GPU, the meshlets
+     * index the vertices themselves.
+     */
+    class Meshlet final : public Accelerator {
+    private:
+        Bvh m_bvh;
+        GLuint g_buffer_meshlet, g_buffer_meshlet_data;
+    public:
+        Meshlet(const scene::Meshlets &meshlets, std::span<const Sphere> spheres, Traversal traversal, bvh::Order order);
+        ~Meshlet() override;
+    public:
+        [[nodiscard]] std::string name() const override;
+        [[nodiscard]] std::string variant() const override;
+        [[nodiscard]] gl::shader::define_map defines() const override;
+        [[nodiscard]] std::size_t stackSize() const override;
+        void bind(GLuint program) const override;
+    };
+
+    /**
+     * Out-of-core geometry: the clusters of the scene (see scene/cluster.h) are paged into a pool of fixed-size slots
+     * when rays reach them, evicting the least recently used. Kernels are var/raytrace/stream_*.glsl: a ray that needs a
+     * cluster that is not resident requests it and waits for the next wave. Vertices and triangles of the scene are not
+     * needed on the GPU, only its spheres.
+     */
+    class Stream final : public Accelerator {
+    public:
+        /**
+         * Entry of the cluster table, matching `Cluster` in var/raytrace/stream.glsl (std430, 32 bytes).
+         */
+        struct Entry {
+            GLfloat min[3];
+            GLuint slot;
+            GLfloat max[3];
+            GLuint request;
+        };
+
+        static constexpr GLuint not_resident = 0xFFFFFFFFu;
+        static constexpr GLuint request_used = 1;
+        static constexpr GLuint request_load = 2;
+        static constexpr GLuint slot_header = 4;
+        // Bytes of `StreamRay`, the state of a ray between waves.
+        static constexpr GLsizeiptr ray_size = 32;
+    private:
+        scene::Clusters m_clusters;
+        // Table order (the order of the tree over the clusters) to index into m_clusters.
+        std::vector<GLuint> m_order;
+        std::vector<Entry> m_table;
+        // Cluster in each slot, or not_resident.
+        std::vector<GLuint> m_slot_cluster;
+        // Load or request stamp of each cluster, for eviction.
+        std::vector<std::uint64_t> m_last_use;
+        std::uint64_t m_clock = 0;
+        // Words per slot and offsets of the references, triangles and positions in a slot, as `slotLayout`.
+        GLuint m_slot_layout[4];
+        GLuint m_slot_attributes;
+        // Split vertices of the cluster being loaded.
+        std::vector<scene::Position> m_positions;
+        std::vector<scene::Attributes> m_attributes;
+        GLuint m_wave = 0;
+        GLsizei m_width = 0, m_height = 0;
+        std::size_t m_loaded_clusters = 0, m_loaded_bytes = 0;
+        GLuint g_buffer_cluster, g_buffer_top, g_buffer_pool, g_buffer_ray, g_buffer_pending;
+    public:
+        /**
+         * `pool_size` is the GPU memory for slots, in bytes. There is always at least one slot.
+         */
+        Stream(const scene::Clusters &clusters, std::size_t pool_size);
+        ~Stream() override;
+    public:
+        [[nodiscard]] std::string name() const override;
+        [[nodiscard]] std::string variant() const override;
+        [[nodiscard]] gl::shader::define_map defines() const override;
+        [[nodiscard]] const char *traceKernel() const override;
+        [[nodiscard]] const char *shadowKernel() const override;
+        [[nodiscard]] const char *fusedKernel() const override;
+        [[nodiscard]] std::size_t stackSize() const override;
+        void bind(GLuint program) const override;
+        void beginPass(GLsizei width, GLsizei height) override;
+        bool nextWave() override;
+    private:
+        void load(GLuint cluster, GLuint slot);
+    };
+}
+
+#endif //RAYTRACE_ACCELERATOR_H
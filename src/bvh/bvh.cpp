@@ -0,0 +1,641 @@
+#include "bvh.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+namespace dragiyski::raytrace::bvh {
+    namespace {
+        constexpr unsigned bin_count = 16;
+        constexpr GLuint max_leaf_size = 8;
+
+        struct Bin {
+            Bounds bounds = Bounds::empty();
+            GLuint count = 0;
+        };
+
+        struct Task {
+            GLuint node;
+            GLuint begin;
+            GLuint end;
+            unsigned depth;
+        };
+
+        void thread(const Tree &tree, GLuint index, std::vector<Node> &output) {
+            const auto &node = tree.nodes[index];
+            auto position = output.size();
+            output.push_back(node);
+            if (node.count == 0) {
+                thread(tree, node.first, output);
+                thread(tree, node.first + 1, output);
+                output[position].first = static_cast<GLuint>(output.size());
+            }
+        }
+
+        struct SpatialReference {
+            GLuint index;
+            Bounds bounds;
+        };
+
+        struct SpatialTask {
+            GLuint node;
+            std::vector<SpatialReference> references;
+            unsigned depth;
+        };
+
+        struct SpatialBin {
+            Bounds bounds = Bounds::empty();
+            GLuint entry = 0;
+            GLuint exit = 0;
+        };
+
+        struct ObjectSplit {
+            int axis = -1;
+            unsigned bin = 0;
+            GLfloat cost = 0.0f;
+            Bounds left = Bounds::empty();
+            Bounds right = Bounds::empty();
+        };
+
+        struct SpatialSplit {
+            int axis = -1;
+            GLfloat position = 0.0f;
+            GLfloat cost = 0.0f;
+            Bounds left = Bounds::empty();
+            Bounds right = Bounds::empty();
+            GLuint left_count = 0;
+            GLuint right_count = 0;
+        };
+
+        unsigned centroidBin(const Bounds &bounds, int axis, GLfloat min, GLfloat scale) {
+            return std::min(bin_count - 1, static_cast<unsigned>((bounds.centroid(axis) - min) * scale));
+        }
+
+        GLfloat splitCost(const Bounds &left, GLuint left_count, const Bounds &right, GLuint right_count, GLfloat parent_area) {
+            return cost_traversal + cost_intersection * (left.area() * static_cast<GLfloat>(left_count) + right.area() * static_cast<GLfloat>(right_count)) / parent_area;
+        }
+
+        ObjectSplit findObjectSplit(const std::vector<SpatialReference> &references, const Bounds &node_bounds, const Bounds &centroid_bounds) {
+            ObjectSplit best;
+            auto parent_area = node_bounds.area();
+            for (int axis = 0; axis < 3; ++axis) {
+                auto extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+                if (!(extent > 0.0f)) {
+                    continue;
+                }
+                std::array<Bin, bin_count> bins;
+                auto scale = static_cast<GLfloat>(bin_count) / extent;
+                for (const auto &reference : references) {
+                    auto &bin = bins[centroidBin(reference.bounds, axis, centroid_bounds.min[axis], scale)];
+                    bin.bounds.extend(reference.bounds);
+                    ++bin.count;
+                }
+                std::array<Bounds, bin_count> right_bounds;
+                std::array<GLuint, bin_count> right_count{};
+                {
+                    auto accumulated = Bounds::empty();
+                    GLuint accumulated_count = 0;
+                    for (auto bin = bin_count - 1; bin > 0; --bin) {
+                        accumulated.extend(bins[bin].bounds);
+                        accumulated_count += bins[bin].count;
+                        right_bounds[bin] = accumulated;
+                        right_count[bin] = accumulated_count;
+                    }
+                }
+                auto accumulated = Bounds::empty();
+                GLuint accumulated_count = 0;
+                for (unsigned bin = 0; bin < bin_count - 1; ++bin) {
+                    accumulated.extend(bins[bin].bounds);
+                    accumulated_count += bins[bin].count;
+                    if (accumulated_count == 0 || right_count[bin + 1] == 0) {
+                        continue;
+                    }
+                    auto cost = splitCost(accumulated, accumulated_count, right_bounds[bin + 1], right_count[bin + 1], parent_area);
+                    if (best.axis < 0 || cost < best.cost) {
+                        best = {axis, bin, cost, accumulated, right_bounds[bin + 1]};
+                    }
+                }
+            }
+            return best;
+        }
+
+        SpatialSplit findSpatialSplit(const std::vector<SpatialReference> &references, const Bounds &node_bounds, const Clip &clip) {
+            SpatialSplit best;
+            auto parent_area = node_bounds.area();
+            for (int axis = 0; axis < 3; ++axis) {
+                auto origin = node_bounds.min[axis];
+                auto width = (node_bounds.max[axis] - origin) / static_cast<GLfloat>(bin_count);
+                if (!(width > 0.0f)) {
+                    continue;
+                }
+                std::array<SpatialBin, bin_count> bins;
+                auto binOf = [&](GLfloat position) {
+                    return std::min(bin_count - 1, static_cast<unsigned>(std::max(0.0f, (position - origin) / width)));
+                };
+                for (const auto &reference : references) {
+                    auto first = binOf(reference.bounds.min[axis]);
+                    auto last = binOf(reference.bounds.max[axis]);
+                    for (auto bin = first; bin <= last; ++bin) {
+                        auto slab = reference.bounds;
+                        slab.min[axis] = std::max(slab.min[axis], origin + width * static_cast<GLfloat>(bin));
+                        slab.max[axis] = std::min(slab.max[axis], bin == bin_count - 1 ? node_bounds.max[axis] : origin + width * static_cast<GLfloat>(bin + 1));
+                        // A reference within a single bin needs no clipping, its bounds are already tight.
+                        bins[bin].bounds.extend(first == last ? reference.bounds : clip(reference.index, slab).intersect(reference.bounds));
+                    }
+                    ++bins[first].entry;
+                    ++bins[last].exit;
+                }
+                std::array<Bounds, bin_count> right_bounds;
+                std::array<GLuint, bin_count> right_count{};
+                {
+                    auto accumulated = Bounds::empty();
+                    GLuint accumulated_count = 0;
+                    for (auto bin = bin_count - 1; bin > 0; --bin) {
+                        accumulated.extend(bins[bin].bounds);
+                        accumulated_count += bins[bin].exit;
+                        right_bounds[bin] = accumulated;
+                        right_count[bin] = accumulated_count;
+                    }
+                }
+                auto accumulated = Bounds::empty();
+                GLuint accumulated_count = 0;
+                for (unsigned bin = 0; bin < bin_count - 1; ++bin) {
+                    accumulated.extend(bins[bin].bounds);
+                    accumulated_count += bins[bin].entry;
+                    if (accumulated_count == 0 || right_count[bin + 1] == 0) {
+                        continue;
+                    }
+                    auto cost = splitCost(accumulated, accumulated_count, right_bounds[bin + 1], right_count[bin + 1], parent_area);
+                    if (best.axis < 0 || cost < best.cost) {
+                        best = {axis, origin + width * static_cast<GLfloat>(bin + 1), cost, accumulated, right_bounds[bin + 1], accumulated_count, right_count[bin + 1]};
+                    }
+                }
+            }
+            return best;
+        }
+
+        void splitSpatial(std::vector<SpatialReference> &&references, const SpatialSplit &split, const Clip &clip, std::vector<SpatialReference> &left, std::vector<SpatialReference> &right) {
+            auto axis = split.axis;
+            std::vector<SpatialReference> straddling;
+            auto left_bounds = Bounds::empty();
+            auto right_bounds = Bounds::empty();
+            for (auto &reference : references) {
+                if (reference.bounds.max[axis] <= split.position) {
+                    left_bounds.extend(reference.bounds);
+                    left.push_back(reference);
+                } else if (reference.bounds.min[axis] >= split.position) {
+                    right_bounds.extend(reference.bounds);
+                    right.push_back(reference);
+                } else {
+                    straddling.push_back(reference);
+                }
+            }
+            // The binned estimate counts every straddling reference on both sides: moving one whole to a side (the
+            // reference "unsplit") is kept when it costs less than the duplicate (Stich et al. 2009).
+            auto left_count = split.left_count;
+            auto right_count = split.right_count;
+            left_bounds.extend(split.left);
+            right_bounds.extend(split.right);
+            for (auto &reference : straddling) {
+                auto cost_split = left_bounds.area() * static_cast<GLfloat>(left_count) + right_bounds.area() * static_cast<GLfloat>(right_count);
+                auto to_left = left_bounds;
+                to_left.extend(reference.bounds);
+                auto to_right = right_bounds;
+                to_right.extend(reference.bounds);
+                auto cost_left = to_left.area() * static_cast<GLfloat>(left_count) + right_bounds.area() * static_cast<GLfloat>(right_count - 1);
+                auto cost_right = left_bounds.area() * static_cast<GLfloat>(left_count - 1) + to_right.area() * static_cast<GLfloat>(right_count);
+                if (cost_left < cost_split && cost_left <= cost_right) {
+                    left_bounds = to_left;
+                    --right_count;
+                    left.push_back(reference);
+                } else if (cost_right < cost_split) {
+                    right_bounds = to_right;
+                    --left_count;
+                    right.push_back(reference);
+                } else {
+                    auto left_box = reference.bounds;
+                    left_box.max[axis] = split.position;
+                    auto right_box = reference.bounds;
+                    right_box.min[axis] = split.position;
+                    auto left_part = clip(reference.index, left_box).intersect(left_box);
+                    auto right_part = clip(reference.index, right_box).intersect(right_box);
+                    // Clipping can lose a sliver touching the plane, then the reference stays on one side only.
+                    if (!left_part.isEmpty()) {
+                        left.push_back({reference.index, left_part});
+                    }
+                    if (!right_part.isEmpty()) {
+                        right.push_back({reference.index, right_part});
+                    }
+                    if (left_part.isEmpty() && right_part.isEmpty()) {
+                        left.push_back(reference);
+                    }
+                }
+            }
+        }
+
+        // Reordering moves blocks: the root alone, or a sibling pair, named by the index of their first node.
+        GLuint blockSize(GLuint block) {
+            return block == 0 ? 1 : 2;
+        }
+
+        void appendChildren(const Tree &tree, GLuint block, std::vector<GLuint> &output) {
+            for (auto index = block; index < block + blockSize(block); ++index) {
+                if (tree.nodes[index].count == 0) {
+                    output.push_back(tree.nodes[index].first);
+                }
+            }
+        }
+
+        unsigned levels(const Tree &tree, GLuint block) {
+            std::vector<GLuint> children;
+            appendChildren(tree, block, children);
+            unsigned result = 0;
+            for (auto child : children) {
+                result = std::max(result, levels(tree, child));
+            }
+            return result + 1;
+        }
+
+        void depthFirst(const Tree &tree, GLuint block, std::vector<GLuint> &output) {
+            output.push_back(block);
+            std::vector<GLuint> children;
+            appendChildren(tree, block, children);
+            for (auto child : children) {
+                depthFirst(tree, child, output);
+            }
+        }
+
+        void vanEmdeBoas(const Tree &tree, GLuint block, unsigned height, std::vector<GLuint> &output) {
+            if (height == 1) {
+                output.push_back(block);
+                return;
+            }
+            auto top = height / 2;
+            vanEmdeBoas(tree, block, top, output);
+            std::vector<GLuint> frontier = {block};
+            for (unsigned level = 0; level < top; ++level) {
+                std::vector<GLuint> next;
+                for (auto parent : frontier) {
+                    appendChildren(tree, parent, next);
+                }
+                frontier = std::move(next);
+            }
+            for (auto child : frontier) {
+                vanEmdeBoas(tree, child, height - top, output);
+            }
+        }
+
+        void treelet(const Tree &tree, std::vector<GLuint> &output) {
+            // Every ray starts at the root, so the first levels are the hottest: keep as many as fit together.
+            std::vector<GLuint> queue = {0};
+            std::size_t head = 0;
+            std::size_t size = 0;
+            while (head < queue.size() && size + blockSize(queue[head]) * sizeof(Node) <= hot_treelet_size) {
+                auto block = queue[head++];
+                output.push_back(block);
+                size += blockSize(block) * sizeof(Node);
+                appendChildren(tree, block, queue);
+            }
+            for (; head < queue.size(); ++head) {
+                depthFirst(tree, queue[head], output);
+            }
+        }
+
+        void assign(Node &node, const Bounds &bounds) {
+            std::copy(std::begin(bounds.min), std::end(bounds.min), std::begin(node.min));
+            std::copy(std::begin(bounds.max), std::end(bounds.max), std::begin(node.max));
+        }
+    }
+
+    Bounds Bounds::empty() {
+        constexpr auto infinity = std::numeric_limits<GLfloat>::infinity();
+        return {{+infinity, +infinity, +infinity}, {-infinity, -infinity, -infinity}};
+    }
+
+    void Bounds::extend(const GLfloat *point) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], point[axis]);
+            max[axis] = std::max(max[axis], point[axis]);
+        }
+    }
+
+    void Bounds::extend(const Bounds &other) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min[axis] = std::min(min[axis], other.min[axis]);
+            max[axis] = std::max(max[axis], other.max[axis]);
+        }
+    }
+
+    Bounds Bounds::intersect(const Bounds &other) const {
+        Bounds result;
+        for (int axis = 0; axis < 3; ++axis) {
+            result.min[axis] = std::max(min[axis], other.min[axis]);
+            result.max[axis] = std::min(max[axis], other.max[axis]);
+        }
+        return result;
+    }
+
+    bool Bounds::isEmpty() const {
+        return !(min[0] <= max[0] && min[1] <= max[1] && min[2] <= max[2]);
+    }
+
+    GLfloat Bounds::centroid(int axis) const {
+        return 0.5f * (min[axis] + max[axis]);
+    }
+
+    GLfloat Bounds::area() const {
+        GLfloat extent[3] = {max[0] - min[0], max[1] - min[1], max[2] - min[2]};
+        if (extent[0] < 0.0f || extent[1] < 0.0f || extent[2] < 0.0f) {
+            return 0.0f;
+        }
+        return 2.0f * (extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0]);
+    }
+
+    Tree build(const std::vector<Bounds> &bounds, const std::vector<GLuint> &references) {
+        Tree tree;
+        std::vector<GLuint> order(bounds.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        tree.nodes.reserve(bounds.empty() ? 1 : 2 * bounds.size() - 1);
+        tree.nodes.push_back({});
+        std::vector<Task> tasks;
+        tasks.push_back({0, 0, static_cast<GLuint>(order.size()), 0});
+
+        while (!tasks.empty()) {
+            auto task = tasks.back();
+            tasks.pop_back();
+            auto count = task.end - task.begin;
+
+            auto node_bounds = Bounds::empty();
+            auto centroid_bounds = Bounds::empty();
+            for (auto i = task.begin; i < task.end; ++i) {
+                const auto &primitive = bounds[order[i]];
+                node_bounds.extend(primitive);
+                GLfloat centroid[3] = {primitive.centroid(0), primitive.centroid(1), primitive.centroid(2)};
+                centroid_bounds.extend(centroid);
+            }
+            assign(tree.nodes[task.node], node_bounds);
+
+            int split_axis = -1;
+            unsigned split_bin = 0;
+            auto split_cost = cost_intersection * static_cast<GLfloat>(count);
+            if (count > 1 && task.depth < max_depth) {
+                auto parent_area = node_bounds.area();
+                for (int axis = 0; axis < 3; ++axis) {
+                    auto extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+                    if (!(extent > 0.0f)) {
+                        continue;
+                    }
+                    std::array<Bin, bin_count> bins;
+                    auto scale = static_cast<GLfloat>(bin_count) / extent;
+                    for (auto i = task.begin; i < task.end; ++i) {
+                        const auto &primitive = bounds[order[i]];
+                        auto bin = std::min(bin_count - 1, static_cast<unsigned>((primitive.centroid(axis) - centroid_bounds.min[axis]) * scale));
+                        bins[bin].bounds.extend(primitive);
+                        ++bins[bin].count;
+                    }
+                    // Sweep from the right to get the cost of every right partition, then from the left to evaluate the splits.
+                    std::array<GLfloat, bin_count> right_area{};
+                    std::array<GLuint, bin_count> right_count{};
+                    {
+                        auto accumulated = Bounds::empty();
+                        GLuint accumulated_count = 0;
+                        for (auto bin = bin_count - 1; bin > 0; --bin) {
+                            accumulated.extend(bins[bin].bounds);
+                            accumulated_count += bins[bin].count;
+                            right_area[bin] = accumulated.area();
+                            right_count[bin] = accumulated_count;
+                        }
+                    }
+                    auto accumulated = Bounds::empty();
+                    GLuint accumulated_count = 0;
+                    for (unsigned bin = 0; bin < bin_count - 1; ++bin) {
+                        accumulated.extend(bins[bin].bounds);
+                        accumulated_count += bins[bin].count;
+                        if (accumulated_count == 0 || right_count[bin + 1] == 0) {
+                            continue;
+                        }
+                        auto cost = cost_traversal + cost_intersection * (accumulated.area() * static_cast<GLfloat>(accumulated_count) + right_area[bin + 1] * static_cast<GLfloat>(right_count[bin + 1])) / parent_area;
+                        if (cost < split_cost) {
+                            split_cost = cost;
+                            split_axis = axis;
+                            split_bin = bin;
+                        }
+                    }
+                }
+            }
+
+            GLuint middle;
+            if (split_axis >= 0) {
+                auto scale = static_cast<GLfloat>(bin_count) / (centroid_bounds.max[split_axis] - centroid_bounds.min[split_axis]);
+                auto iterator = std::partition(order.begin() + task.begin, order.begin() + task.end, [&](GLuint index) {
+                    return std::min(bin_count - 1, static_cast<unsigned>((bounds[index].centroid(split_axis) - centroid_bounds.min[split_axis]) * scale)) <= split_bin;
+                });
+                middle = static_cast<GLuint>(iterator - order.begin());
+            } else if (count > max_leaf_size && task.depth < max_depth) {
+                // SAH prefers a leaf, but it is too large (usually coincident centroids): split in the middle.
+                middle = task.begin + count / 2;
+            } else {
+                tree.nodes[task.node].first = task.begin;
+                tree.nodes[task.node].count = count;
+                continue;
+            }
+
+            auto left = static_cast<GLuint>(tree.nodes.size());
+            tree.nodes.push_back({});
+            tree.nodes.push_back({});
+            tree.nodes[task.node].first = left;
+            tree.nodes[task.node].count = 0;
+            tasks.push_back({left + 1, middle, task.end, task.depth + 1});
+            tasks.push_back({left, task.begin, middle, task.depth + 1});
+        }
+
+        tree.references.resize(order.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            tree.references[i] = references[order[i]];
+        }
+        return tree;
+    }
+
+    Tree buildSpatial(const std::vector<Bounds> &bounds, const std::vector<GLuint> &references, const Clip &clip, GLfloat alpha) {
+        Tree tree;
+        std::vector<SpatialReference> root;
+        root.reserve(bounds.size());
+        auto scene_bounds = Bounds::empty();
+        for (std::size_t index = 0; index < bounds.size(); ++index) {
+            root.push_back({static_cast<GLuint>(index), bounds[index]});
+            scene_bounds.extend(bounds[index]);
+        }
+        auto overlap_limit = alpha * scene_bounds.area();
+
+        tree.nodes.push_back({});
+        std::vector<SpatialTask> tasks;
+        tasks.push_back({0, std::move(root), 0});
+
+        while (!tasks.empty()) {
+            auto task = std::move(tasks.back());
+            tasks.pop_back();
+            auto count = static_cast<GLuint>(task.references.size());
+
+            auto node_bounds = Bounds::empty();
+            auto centroid_bounds = Bounds::empty();
+            for (const auto &reference : task.references) {
+                node_bounds.extend(reference.bounds);
+                GLfloat centroid[3] = {reference.bounds.centroid(0), reference.bounds.centroid(1), reference.bounds.centroid(2)};
+                centroid_bounds.extend(centroid);
+            }
+            assign(tree.nodes[task.node], node_bounds);
+
+            std::vector<SpatialReference> left, right;
+            auto leaf_cost = cost_intersection * static_cast<GLfloat>(count);
+            if (count > 1 && task.depth < max_depth) {
+                auto object = findObjectSplit(task.references, node_bounds, centroid_bounds);
+                SpatialSplit spatial;
+                // Space is only split where the object split overlaps: elsewhere it cannot win and only costs build time.
+                if (object.axis < 0 || object.left.intersect(object.right).area() > overlap_limit) {
+                    spatial = findSpatialSplit(task.references, node_bounds, clip);
+                }
+                auto object_wins = object.axis >= 0 && (spatial.axis < 0 || object.cost <= spatial.cost);
+                if (object_wins && object.cost < leaf_cost) {
+                    auto extent = centroid_bounds.max[object.axis] - centroid_bounds.min[object.axis];
+                    auto scale = static_cast<GLfloat>(bin_count) / extent;
+                    for (auto &reference : task.references) {
+                        (centroidBin(reference.bounds, object.axis, centroid_bounds.min[object.axis], scale) <= object.bin ? left : right).push_back(reference);
+                    }
+                } else if (!object_wins && spatial.axis >= 0 && spatial.cost < leaf_cost) {
+                    splitSpatial(std::move(task.references), spatial, clip, left, right);
+                    if (left.empty() || right.empty()) {
+                        task.references = left.empty() ? std::move(right) : std::move(left);
+                        left.clear();
+                        right.clear();
+                        count = static_cast<GLuint>(task.references.size());
+                    }
+                }
+                if ((left.empty() || right.empty()) && count > max_leaf_size) {
+                    // Neither split beats a leaf, but it is too large: split in the middle.
+                    left.assign(task.references.begin(), task.references.begin() + count / 2);
+                    right.assign(task.references.begin() + count / 2, task.references.end());
+                }
+            }
+
+            if (left.empty() || right.empty()) {
+                tree.nodes[task.node].first = static_cast<GLuint>(tree.references.size());
+                tree.nodes[task.node].count = count;
+                for (const auto &reference : task.references) {
+                    tree.references.push_back(references[reference.index]);
+                }
+                continue;
+            }
+
+            auto first = static_cast<GLuint>(tree.nodes.size());
+            tree.nodes.push_back({});
+            tree.nodes.push_back({});
+            tree.nodes[task.node].first = first;
+            tree.nodes[task.node].count = 0;
+            tasks.push_back({first + 1, std::move(right), task.depth + 1});
+            tasks.push_back({first, std::move(left), task.depth + 1});
+        }
+        return tree;
+    }
+
+    Bounds clipTriangle(const GLfloat *a, const GLfloat *b, const GLfloat *c, const Bounds &box) {
+        // Sutherland-Hodgman against the six planes of the box; a triangle clipped by six planes has at most nine vertices.
+        std::array<std::array<GLfloat, 3>, 9> polygon, clipped;
+        std::size_t size = 3;
+        std::copy(a, a + 3, polygon[0].begin());
+        std::copy(b, b + 3, polygon[1].begin());
+        std::copy(c, c + 3, polygon[2].begin());
+        for (int plane = 0; plane < 6 && size > 0; ++plane) {
+            auto axis = plane / 2;
+            auto sign = plane % 2 == 0 ? 1.0f : -1.0f;
+            auto limit = plane % 2 == 0 ? box.min[axis] : box.max[axis];
+            std::size_t clipped_size = 0;
+            for (std::size_t i = 0; i < size; ++i) {
+                const auto &current = polygon[i];
+                const auto &next = polygon[(i + 1) % size];
+                auto d_current = sign * (current[axis] - limit);
+                auto d_next = sign * (next[axis] - limit);
+                if (d_current >= 0.0f) {
+                    clipped[clipped_size++] = current;
+                }
+                if ((d_current >= 0.0f) != (d_next >= 0.0f)) {
+                    auto t = d_current / (d_current - d_next);
+                    auto &point = clipped[clipped_size++];
+                    for (int k = 0; k < 3; ++k) {
+                        point[k] = current[k] + t * (next[k] - current[k]);
+                    }
+                    point[axis] = limit;
+                }
+            }
+            polygon = clipped;
+            size = clipped_size;
+        }
+        auto result = Bounds::empty();
+        for (std::size_t i = 0; i < size; ++i) {
+            result.extend(polygon[i].data());
+        }
+        return result.intersect(box);
+    }
+
+    Tree reorder(const Tree &tree, Order order) {
+        if (tree.references.empty()) {
+            // The single node of an empty tree has no children, although its count is zero.
+            return tree;
+        }
+        std::vector<GLuint> blocks;
+        blocks.reserve(tree.nodes.size() / 2 + 1);
+        switch (order) {
+            case Order::depth_first:
+                depthFirst(tree, 0, blocks);
+                break;
+            case Order::van_emde_boas:
+                vanEmdeBoas(tree, 0, levels(tree, 0), blocks);
+                break;
+            case Order::treelet:
+                treelet(tree, blocks);
+                break;
+        }
+
+        std::vector<GLuint> position(tree.nodes.size());
+        GLuint next = 0;
+        for (auto block : blocks) {
+            for (auto index = block; index < block + blockSize(block); ++index) {
+                position[index] = next++;
+            }
+        }
+        Tree result;
+        result.nodes.resize(tree.nodes.size());
+        result.references = tree.references;
+        for (std::size_t index = 0; index < tree.nodes.size(); ++index) {
+            auto &node = result.nodes[position[index]];
+            node = tree.nodes[index];
+            if (node.count == 0) {
+                node.first = position[node.first];
+            }
+        }
+        return result;
+    }
+
+    std::vector<Node> thread(const Tree &tree) {
+        std::vector<Node> output;
+        output.reserve(tree.nodes.size());
+        if (tree.references.empty()) {
+            // The root of an empty tree is an empty interior node: a miss skips straight to the end.
+            output.push_back(tree.nodes[0]);
+            output[0].first = 1;
+            return output;
+        }
+        thread(tree, 0, output);
+        return output;
+    }
+
+    std::vector<std::size_t> subtreeSizes(const Tree &tree) {
+        std::vector<std::size_t> sizes(tree.nodes.size(), 0);
+        // Children always follow their parent, so a reverse pass sees them first.
+        for (auto index = tree.nodes.size(); index-- > 0;) {
+            const auto &node = tree.nodes[index];
+            sizes[index] = node.count > 0 ? node.count : sizes[node.first] + sizes[node.first + 1];
+        }
+        return sizes;
+    }
+}
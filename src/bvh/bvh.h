@@ -0,0 +1,112 @@
+#ifndef RAYTRACE_BVH_H
+#define RAYTRACE_BVH_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <GL/gl.h>
+
+namespace dragiyski::raytrace::bvh {
+    struct Bounds {
+        GLfloat min[3];
+        GLfloat max[3];
+
+        static Bounds empty();
+
+        void extend(const GLfloat *point);
+        void extend(const Bounds &other);
+        [[nodiscard]] Bounds intersect(const Bounds &other) const;
+        [[nodiscard]] bool isEmpty() const;
+        [[nodiscard]] GLfloat centroid(int axis) const;
+        [[nodiscard]] GLfloat area() const;
+    };
+
+    /**
+     * Node of the flattened tree, matching `Node` in var/raytrace/bvh.glsl (std430, 32 bytes).
+     * Interior nodes have `count == 0` and `first` is the index of the left child, the right child follows it.
+     * Leaves reference `count` entries of the reference array starting at `first`.
+     */
+    struct Node {
+        GLfloat min[3];
+        GLuint first;
+        GLfloat max[3];
+        GLuint count;
+    };
+
+    /**
+     * A reference is an index into the triangle array, or into the sphere array when `reference_sphere` is set.
+     */
+    constexpr GLuint reference_sphere = 0x80000000u;
+    constexpr GLuint reference_index = 0x7FFFFFFFu;
+
+    struct Tree {
+        std::vector<Node> nodes;
+        std::vector<GLuint> references;
+    };
+
+    /**
+     * Builds a binned SAH tree over primitives given by their bounds and references (both arrays have the same length).
+     * The depth never exceeds `max_depth`, which is the traversal stack size in the shaders.
+     */
+    Tree build(const std::vector<Bounds> &bounds, const std::vector<GLuint> &references);
+
+    constexpr unsigned max_depth = 32;
+
+    /**
+     * Costs of the surface area heuristic, relative to each other: one box test and one primitive test.
+     */
+    constexpr GLfloat cost_traversal = 1.0f;
+    constexpr GLfloat cost_intersection = 1.0f;
+
+    /**
+     * Bounds of the part of primitive `index` (an index into the arrays given to the builder) inside `box`.
+     */
+    using Clip = std::function<Bounds(std::size_t index, const Bounds &box)>;
+
+    /**
+     * Builds a spatial split tree (SBVH): like `build`, but a node whose best object split leaves children overlapping by
+     * more than `alpha` times the surface area of the scene also tries to split space, which clips the primitives
+     * crossing the plane and references them from both sides. Smaller `alpha` splits more and duplicates more
+     * references; a very large one degrades to `build`.
+     */
+    Tree buildSpatial(const std::vector<Bounds> &bounds, const std::vector<GLuint> &references, const Clip &clip, GLfloat alpha);
+
+    /**
+     * Bounds of the part of the triangle inside `box`.
+     */
+    Bounds clipTriangle(const GLfloat *a, const GLfloat *b, const GLfloat *c, const Bounds &box);
+
+    /**
+     * Memory order of the nodes. Siblings always stay adjacent, so the orders differ in where each sibling pair goes.
+     */
+    enum class Order {
+        // Pre-order over the sibling pairs, as produced by `build`: a subtree is contiguous.
+        depth_first,
+        // Cache-oblivious: the top half of the levels first, then every bottom subtree, each laid out recursively.
+        van_emde_boas,
+        // The top levels, breadth first, in one hot block of `hot_treelet_size` bytes, then depth-first subtrees.
+        treelet
+    };
+
+    constexpr std::size_t hot_treelet_size = 4096;
+
+    /**
+     * Copy of the tree with the nodes in the given order. The root stays at index 0 and the references are unchanged.
+     */
+    Tree reorder(const Tree &tree, Order order);
+
+    /**
+     * Depth-first copy of the tree with miss (skip) links, for traversal without a stack.
+     * Interior nodes keep `count == 0`, but `first` is the index of the node following their whole subtree: traversal
+     * continues there when the box is missed and with the next node (the left child) when it is hit.
+     * Leaves are unchanged and always continue with the next node. Traversal ends at index `nodes.size()`.
+     */
+    std::vector<Node> thread(const Tree &tree);
+
+    /**
+     * Number of references below every node of a tree in the layout of `build`.
+     */
+    std::vector<std::size_t> subtreeSizes(const Tree &tree);
+}
+
+#endif //RAYTRACE_BVH_H
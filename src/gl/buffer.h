@@ -0,0 +1,29 @@
+#ifndef RAYTRACE_BUFFER_H
+#define RAYTRACE_BUFFER_H
+
+#include <algorithm>
+#include <span>
+#include <vector>
+#include <GL/gl.h>
+
+namespace gl::buffer {
+    /**
+     * Immutable storage buffer with a copy of `data`. `flags` are those of glBufferStorage, e.g. GL_DYNAMIC_STORAGE_BIT
+     * for a buffer updated with glBufferSubData.
+     */
+    template<typename T>
+    GLuint createStorage(std::span<const T> data, GLbitfield flags = 0) {
+        GLuint buffer;
+        glCreateBuffers(1, &buffer);
+        // Zero-sized storage is invalid, so an empty array still gets one (unused) element.
+        glNamedBufferStorage(buffer, std::max<std::size_t>(data.size(), 1) * sizeof(T), data.empty() ? nullptr : data.data(), flags);
+        return buffer;
+    }
+
+    template<typename T>
+    GLuint createStorage(const std::vector<T> &data, GLbitfield flags = 0) {
+        return createStorage(std::span<const T>(data), flags);
+    }
+}
+
+#endif //RAYTRACE_BUFFER_H
@@ -1,11 +1,56 @@
 #include "shader.h"
+#include <filesystem>
 #include <fstream>
-#include <streambuf>
+#include <sstream>
 #include <string>
+#include <vector>
 
-GLuint gl::shader::fromFile(GLenum type, const char *filename) {
-    std::ifstream stream(filename);
-    std::string source((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+namespace {
+    // Textually expands `#include "file"` lines, relative to the including file.
+    // Every file gets its own source string number in `#line`, so compiler messages still point at the right file.
+    void load(const std::filesystem::path &filename, std::vector<std::filesystem::path> &files, std::ostringstream &output) {
+        std::ifstream stream(filename);
+        if (!stream) {
+            throw gl::shader::parse_error(("Unable to open shader file: " + filename.string()).c_str());
+        }
+        auto source_number = files.size();
+        files.push_back(filename);
+        std::string line;
+        std::size_t line_number = 0;
+        while (std::getline(stream, line)) {
+            ++line_number;
+            auto directive = line.find_first_not_of(" \t");
+            if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0) {
+                output << line << '\n';
+                continue;
+            }
+            auto first = line.find('"', directive);
+            auto last = first == std::string::npos ? std::string::npos : line.find('"', first + 1);
+            if (last == std::string::npos) {
+                throw gl::shader::parse_error((filename.string() + ":" + std::to_string(line_number) + ": malformed #include").c_str());
+            }
+            auto included = filename.parent_path() / line.substr(first + 1, last - first - 1);
+            output << "#line 1 " << files.size() << '\n';
+            load(included, files, output);
+            output << "#line " << (line_number + 1) << ' ' << source_number << '\n';
+        }
+    }
+}
+
+GLuint gl::shader::fromFile(GLenum type, const char *filename, const define_map &defines) {
+    std::vector<std::filesystem::path> files;
+    std::ostringstream output;
+    load(filename, files, output);
+    auto source = output.str();
+    if (!defines.empty()) {
+        std::string preamble;
+        for (const auto &[name, value] : defines) {
+            preamble += "#define " + name + " " + value + "\n";
+        }
+        preamble += "#line 2 0\n";
+        auto position = source.compare(0, 8, "#version") == 0 ? source.find('\n') + 1 : 0;
+        source.insert(position, preamble);
+    }
     return fromSource(type, source.c_str());
 }
 
@@ -1,11 +1,19 @@
 #ifndef RAYTRACE_SHADER_H
 #define RAYTRACE_SHADER_H
 
+#include <map>
 #include <stdexcept>
+#include <string>
 #include <GL/gl.h>
 
 namespace gl::shader {
-        GLuint fromFile(GLenum type, const char *filename);
+        typedef std::map<std::string, std::string> define_map;
+
+        /**
+         * Loads a shader, expanding `#include "file"` and adding `#define name value` for every entry of `defines`
+         * right after the `#version` directive.
+         */
+        GLuint fromFile(GLenum type, const char *filename, const define_map &defines = {});
         GLuint fromSource(GLenum type, const char *source);
 
         class parse_error : public std::runtime_error {
@@ -0,0 +1,312 @@
+#include "graph.h"
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace dragiyski::raytrace::graph {
+    namespace {
+        GLbitfield barrierBit(Access access, bool buffer) {
+            switch (access) {
+                case Access::image:
+                    return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+                case Access::storage:
+                    return GL_SHADER_STORAGE_BARRIER_BIT;
+                case Access::atomic:
+                    return GL_ATOMIC_COUNTER_BARRIER_BIT;
+                case Access::framebuffer:
+                    return GL_FRAMEBUFFER_BARRIER_BIT;
+                case Access::transfer:
+                    return buffer ? GL_BUFFER_UPDATE_BARRIER_BIT : GL_TEXTURE_UPDATE_BARRIER_BIT;
+            }
+            return GL_ALL_BARRIER_BITS;
+        }
+
+        bool isIncoherent(Access access) {
+            return access == Access::image || access == Access::storage || access == Access::atomic;
+        }
+
+        std::size_t texelSize(GLenum format) {
+            switch (format) {
+                case GL_R8:
+                    return 1;
+                case GL_R32F:
+                case GL_R32UI:
+                    return 4;
+                case GL_RGBA32F:
+                    return 16;
+                default:
+                    throw std::invalid_argument("Unsupported transient texture format");
+            }
+        }
+
+        bool inGroup(std::string_view name, std::string_view group) {
+            return group.empty() || name == group || (name.size() > group.size() && name.starts_with(group) && name[group.size()] == '.');
+        }
+    }
+
+    Graph::Graph(Graph &&other) noexcept
+        : m_resources(std::move(other.m_resources)),
+          m_passes(std::move(other.m_passes)),
+          m_schedule(std::move(other.m_schedule)),
+          m_textures(std::exchange(other.m_textures, {})),
+          m_state(std::move(other.m_state)) {
+    }
+
+    Graph::~Graph() {
+        release();
+    }
+
+    Graph &Graph::operator=(Graph &&other) noexcept {
+        if (this != &other) {
+            release();
+            m_resources = std::move(other.m_resources);
+            m_passes = std::move(other.m_passes);
+            m_schedule = std::move(other.m_schedule);
+            m_textures = std::exchange(other.m_textures, {});
+            m_state = std::move(other.m_state);
+        }
+        return *this;
+    }
+
+    resource_id Graph::buffer(std::string name) {
+        m_resources.push_back({std::move(name), true, false, {}, nullptr, 0});
+        return m_resources.size() - 1;
+    }
+
+    resource_id Graph::texture(std::string name) {
+        m_resources.push_back({std::move(name), false, false, {}, nullptr, 0});
+        return m_resources.size() - 1;
+    }
+
+    resource_id Graph::transient(std::string name, const Texture &texture, GLuint *object) {
+        m_resources.push_back({std::move(name), false, true, texture, object, 0});
+        return m_resources.size() - 1;
+    }
+
+    void Graph::pass(std::string name, std::vector<Use> uses, std::function<void()> execute) {
+        for (const auto &use : uses) {
+            if (use.resource >= m_resources.size()) {
+                throw std::invalid_argument("Pass " + name + " uses an unknown resource");
+            }
+        }
+        m_passes.push_back({std::move(name), std::move(uses), std::move(execute)});
+    }
+
+    void Graph::compile(GLsizei width, GLsizei height) {
+        release();
+        auto count = m_passes.size();
+
+        // A pass waits for the last writer of everything it touches, and a write waits for the readers since.
+        std::vector<std::vector<std::size_t>> successors(count);
+        std::vector<std::size_t> predecessors(count, 0);
+        std::vector<std::optional<std::size_t>> writer(m_resources.size());
+        std::vector<std::vector<std::size_t>> readers(m_resources.size());
+        for (std::size_t pass = 0; pass < count; ++pass) {
+            std::vector<std::size_t> before;
+            for (const auto &use : m_passes[pass].uses) {
+                if (writer[use.resource]) {
+                    before.push_back(*writer[use.resource]);
+                }
+                if (use.write) {
+                    before.insert(before.end(), readers[use.resource].begin(), readers[use.resource].end());
+                }
+            }
+            std::sort(before.begin(), before.end());
+            before.erase(std::unique(before.begin(), before.end()), before.end());
+            for (auto other : before) {
+                if (other != pass) {
+                    successors[other].push_back(pass);
+                    ++predecessors[pass];
+                }
+            }
+            for (const auto &use : m_passes[pass].uses) {
+                if (!use.write) {
+                    readers[use.resource].push_back(pass);
+                }
+            }
+            for (const auto &use : m_passes[pass].uses) {
+                if (use.write) {
+                    writer[use.resource] = pass;
+                    readers[use.resource].clear();
+                }
+            }
+        }
+
+        // Until the textures are shared, every resource is its own slot. The frame is scheduled from a clean state.
+        for (std::size_t resource = 0; resource < m_resources.size(); ++resource) {
+            m_resources[resource].slot = resource;
+        }
+        std::vector<State> simulated(m_resources.size());
+        std::vector<bool> scheduled(count, false);
+        m_schedule.clear();
+        while (m_schedule.size() < count) {
+            std::optional<std::size_t> next;
+            for (std::size_t pass = 0; pass < count; ++pass) {
+                if (scheduled[pass] || predecessors[pass] != 0) {
+                    continue;
+                }
+                if (!next) {
+                    next = pass;
+                }
+                if (barrier(simulated, m_passes[pass].uses) == 0) {
+                    next = pass;
+                    break;
+                }
+            }
+            access(simulated, barrier(simulated, m_passes[*next].uses), m_passes[*next].uses);
+            scheduled[*next] = true;
+            m_schedule.push_back(*next);
+            for (auto successor : successors[*next]) {
+                --predecessors[successor];
+            }
+        }
+
+        std::vector<std::size_t> first(m_resources.size(), count), last(m_resources.size(), 0);
+        for (std::size_t position = 0; position < count; ++position) {
+            for (const auto &use : m_passes[m_schedule[position]].uses) {
+                first[use.resource] = std::min(first[use.resource], position);
+                last[use.resource] = std::max(last[use.resource], position);
+            }
+        }
+        std::vector<resource_id> transients;
+        std::size_t slots = 0;
+        for (std::size_t resource = 0; resource < m_resources.size(); ++resource) {
+            if (m_resources[resource].transient) {
+                transients.push_back(resource);
+            } else {
+                m_resources[resource].slot = slots++;
+            }
+        }
+        std::sort(transients.begin(), transients.end(), [&](resource_id a, resource_id b) {
+            return first[a] < first[b];
+        });
+        struct Allocation {
+            Texture texture;
+            std::size_t last;
+            std::size_t slot;
+        };
+        std::vector<Allocation> allocations;
+        for (auto resource : transients) {
+            auto &description = m_resources[resource];
+            if (first[resource] == count) {
+                // No pass uses it.
+                *description.object = 0;
+                description.slot = slots++;
+                continue;
+            }
+            auto shared = std::find_if(allocations.begin(), allocations.end(), [&](const Allocation &allocation) {
+                return allocation.last < first[resource] && allocation.texture.target == description.texture.target && allocation.texture.format == description.texture.format && allocation.texture.layers == description.texture.layers;
+            });
+            if (shared == allocations.end()) {
+                allocations.push_back({description.texture, last[resource], slots++});
+                shared = allocations.end() - 1;
+            }
+            shared->last = last[resource];
+            description.slot = shared->slot;
+        }
+
+        width = std::max(width, 1);
+        height = std::max(height, 1);
+        std::size_t bytes = 0;
+        std::vector<GLuint> slotTexture(slots, 0);
+        for (const auto &allocation : allocations) {
+            const auto &texture = allocation.texture;
+            GLuint object;
+            glCreateTextures(texture.target, 1, &object);
+            if (texture.target == GL_TEXTURE_2D_ARRAY) {
+                glTextureStorage3D(object, 1, texture.format, width, height, texture.layers);
+            } else {
+                glTextureStorage2D(object, 1, texture.format, width, height);
+            }
+            glTextureParameteri(object, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTextureParameteri(object, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            m_textures.push_back(object);
+            slotTexture[allocation.slot] = object;
+            bytes += texelSize(texture.format) * std::size_t(width) * std::size_t(height) * std::size_t(texture.layers);
+        }
+        for (auto resource : transients) {
+            if (first[resource] != count) {
+                *m_resources[resource].object = slotTexture[m_resources[resource].slot];
+            }
+        }
+        // Whatever ran before may still be writing to the buffers and textures of the caller.
+        m_state.assign(slots, State{true, 0, true});
+
+        std::string order;
+        for (auto pass : m_schedule) {
+            order += (order.empty() ? "" : ", ") + m_passes[pass].name;
+        }
+        fprintf(stderr, "[graph][%d][%d]: %s; %zu transient textures in %zu, %zu bytes\n", width, height, order.c_str(), transients.size(), allocations.size(), bytes);
+    }
+
+    void Graph::execute(std::string_view group) {
+        for (auto index : m_schedule) {
+            auto &pass = m_passes[index];
+            if (!inGroup(pass.name, group)) {
+                continue;
+            }
+            use(pass.uses);
+            pass.execute();
+        }
+    }
+
+    void Graph::use(const std::vector<Use> &uses) {
+        auto bits = barrier(m_state, uses);
+        if (bits != 0) {
+            glMemoryBarrier(bits);
+        }
+        access(m_state, bits, uses);
+    }
+
+    GLbitfield Graph::barrier(std::vector<State> state, const std::vector<Use> &uses) const {
+        GLbitfield bits = 0;
+        for (const auto &use : uses) {
+            const auto &resource = m_resources[use.resource];
+            auto &current = state[resource.slot];
+            auto bit = barrierBit(use.access, resource.buffer);
+            // Earlier writes must be visible to this access, earlier reads must be done before this one writes.
+            if ((current.written && (current.visible & bit) == 0) || (use.write && current.read)) {
+                bits |= bit;
+            }
+            // Like a host clear in front of the atomic counters of the pass.
+            if (use.write && !isIncoherent(use.access)) {
+                current = State();
+            }
+        }
+        return bits;
+    }
+
+    void Graph::access(std::vector<State> &state, GLbitfield barrier, const std::vector<Use> &uses) const {
+        if (barrier != 0) {
+            for (auto &current : state) {
+                current.visible |= barrier;
+                current.read = false;
+            }
+        }
+        for (const auto &use : uses) {
+            auto &current = state[m_resources[use.resource].slot];
+            if (!isIncoherent(use.access)) {
+                // Ordered after everything before it, which the barrier made visible, and before everything after it.
+                if (use.write) {
+                    current = State();
+                }
+                continue;
+            }
+            if (use.write) {
+                current.written = true;
+                current.visible = 0;
+            } else {
+                current.read = true;
+            }
+        }
+    }
+
+    void Graph::release() {
+        if (!m_textures.empty()) {
+            glDeleteTextures(GLsizei(m_textures.size()), m_textures.data());
+            m_textures.clear();
+        }
+    }
+}
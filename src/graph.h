@@ -0,0 +1,151 @@
+#ifndef RAYTRACE_GRAPH_H
+#define RAYTRACE_GRAPH_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <GL/gl.h>
+
+namespace dragiyski::raytrace::graph {
+    typedef std::size_t resource_id;
+
+    /**
+     * How a pass touches a resource, which decides the barrier bit that makes earlier shader writes visible to it.
+     * Only image, storage and atomic accesses are incoherent: the other ones are ordered by GL itself.
+     */
+    enum class Access {
+        // imageLoad/imageStore.
+        image,
+        // Shader storage blocks.
+        storage,
+        // Atomic counters.
+        atomic,
+        // Attachment of the bound framebuffer.
+        framebuffer,
+        // glClear*, glGet*, glCopy* and glSubData of the host.
+        transfer,
+    };
+
+    /**
+     * The uses of a pass are listed in the order the pass makes them.
+     */
+    struct Use {
+        resource_id resource;
+        Access access;
+        bool write;
+    };
+
+    inline Use read(resource_id resource, Access access) {
+        return {resource, access, false};
+    }
+
+    inline Use write(resource_id resource, Access access) {
+        return {resource, access, true};
+    }
+
+    /**
+     * Screen sized texture with a single level.
+     */
+    struct Texture {
+        GLenum target;
+        GLenum format;
+        GLsizei layers = 1;
+    };
+
+    /**
+     * Passes of a frame with the resources they touch.
+     *
+     * The passes are declared in a valid order. compile() keeps the order of every pair of passes touching the same
+     * resource (unless both only read it), and among the passes whose inputs are ready runs first the ones that need no
+     * barrier, so the barriers left cover as many passes as possible. Every access is then checked against the
+     * accesses before it, this frame or the previous ones, and glMemoryBarrier is called with only the bits the pass
+     * needs. Transient textures live from their first to their last pass: the graph allocates them, and ones of the
+     * same kind whose lifetimes do not overlap share a texture.
+     */
+    class Graph {
+    private:
+        struct Resource {
+            std::string name;
+            bool buffer;
+            bool transient;
+            Texture texture;
+            // Where the texture of a transient is published for the passes.
+            GLuint *object;
+            // Index into m_state: transients that share a texture share it.
+            std::size_t slot;
+        };
+        struct Pass {
+            std::string name;
+            std::vector<Use> uses;
+            std::function<void()> execute;
+        };
+        /**
+         * Synchronization state of a buffer or texture.
+         */
+        struct State {
+            // An incoherent write not yet followed by a barrier with every bit.
+            bool written = false;
+            // Barrier bits since that write.
+            GLbitfield visible = 0;
+            // An incoherent read not yet followed by any barrier, which a write must wait for.
+            bool read = false;
+        };
+        std::vector<Resource> m_resources;
+        std::vector<Pass> m_passes;
+        // Indices into m_passes, in execution order.
+        std::vector<std::size_t> m_schedule;
+        std::vector<GLuint> m_textures;
+        std::vector<State> m_state;
+    public:
+        Graph() = default;
+        Graph(const Graph &) = delete;
+        Graph(Graph &&other) noexcept;
+        ~Graph();
+    public:
+        Graph &operator=(const Graph &) = delete;
+        Graph &operator=(Graph &&other) noexcept;
+    public:
+        /**
+         * A buffer that outlives the frame, owned by the caller.
+         */
+        resource_id buffer(std::string name);
+
+        /**
+         * A texture that outlives the frame, owned by the caller.
+         */
+        resource_id texture(std::string name);
+
+        /**
+         * A texture that only lives within the frame. Its name is written to `object` by compile().
+         */
+        resource_id transient(std::string name, const Texture &texture, GLuint *object);
+
+        /**
+         * Names are dotted: execute() selects a pass by its name or by a prefix of it.
+         */
+        void pass(std::string name, std::vector<Use> uses, std::function<void()> execute);
+
+        /**
+         * Schedules the passes and allocates the transient textures at the size of the screen.
+         */
+        void compile(GLsizei width, GLsizei height);
+
+        /**
+         * Runs the scheduled passes, or only the group named `group`, each behind the barrier it needs.
+         */
+        void execute(std::string_view group = {});
+
+        /**
+         * Waits for the passes before accesses made outside of them, like reading a counter back.
+         */
+        void use(const std::vector<Use> &uses);
+    private:
+        [[nodiscard]] GLbitfield barrier(std::vector<State> state, const std::vector<Use> &uses) const;
+        void access(std::vector<State> &state, GLbitfield barrier, const std::vector<Use> &uses) const;
+        void release();
+    };
+}
+
+#endif //RAYTRACE_GRAPH_H
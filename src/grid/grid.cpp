@@ -0,0 +1,78 @@
+#include "grid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dragiyski::raytrace::grid {
+    Grid build(const std::vector<bvh::Bounds> &bounds, const std::vector<GLuint> &references, GLfloat density) {
+        Grid grid;
+        auto scene_bounds = bvh::Bounds::empty();
+        for (const auto &primitive : bounds) {
+            scene_bounds.extend(primitive);
+        }
+        if (bounds.empty()) {
+            scene_bounds = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}};
+        }
+
+        // Flat scenes still get a (thin) volume, so the cell count below stays finite.
+        GLfloat extent[3];
+        GLfloat max_extent = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            extent[axis] = scene_bounds.max[axis] - scene_bounds.min[axis];
+            max_extent = std::max(max_extent, extent[axis]);
+        }
+        auto min_extent = std::max(max_extent * 1e-3f, 1e-6f);
+        for (int axis = 0; axis < 3; ++axis) {
+            extent[axis] = std::max(extent[axis], min_extent);
+        }
+        // Cells of edge `scale` give `density * N` cells in total (Cleary and Wyvill).
+        auto volume = extent[0] * extent[1] * extent[2];
+        auto scale = std::cbrt(static_cast<GLfloat>(std::max<std::size_t>(bounds.size(), 1)) * density / volume);
+        for (int axis = 0; axis < 3; ++axis) {
+            grid.resolution[axis] = std::clamp(static_cast<GLint>(std::ceil(extent[axis] * scale)), 1, max_resolution);
+            grid.min[axis] = scene_bounds.min[axis];
+            grid.cell_size[axis] = extent[axis] / static_cast<GLfloat>(grid.resolution[axis]);
+        }
+
+        auto cellRange = [&](const bvh::Bounds &primitive, GLint *first, GLint *last) {
+            for (int axis = 0; axis < 3; ++axis) {
+                first[axis] = std::clamp(static_cast<GLint>(std::floor((primitive.min[axis] - grid.min[axis]) / grid.cell_size[axis])), 0, grid.resolution[axis] - 1);
+                last[axis] = std::clamp(static_cast<GLint>(std::floor((primitive.max[axis] - grid.min[axis]) / grid.cell_size[axis])), 0, grid.resolution[axis] - 1);
+            }
+        };
+        auto cellIndex = [&](GLint x, GLint y, GLint z) {
+            return static_cast<std::size_t>(x) + static_cast<std::size_t>(grid.resolution[0]) * (static_cast<std::size_t>(y) + static_cast<std::size_t>(grid.resolution[1]) * static_cast<std::size_t>(z));
+        };
+
+        // Count, prefix sum, fill: the references of a cell end up contiguous without per-cell allocations.
+        auto cell_count = static_cast<std::size_t>(grid.resolution[0]) * grid.resolution[1] * grid.resolution[2];
+        grid.cells.assign(cell_count + 1, 0);
+        for (const auto &primitive : bounds) {
+            GLint first[3], last[3];
+            cellRange(primitive, first, last);
+            for (auto z = first[2]; z <= last[2]; ++z) {
+                for (auto y = first[1]; y <= last[1]; ++y) {
+                    for (auto x = first[0]; x <= last[0]; ++x) {
+                        ++grid.cells[cellIndex(x, y, z) + 1];
+                    }
+                }
+            }
+        }
+        for (std::size_t cell = 0; cell < cell_count; ++cell) {
+            grid.cells[cell + 1] += grid.cells[cell];
+        }
+        grid.references.resize(grid.cells[cell_count]);
+        std::vector<GLuint> fill(grid.cells.begin(), grid.cells.end() - 1);
+        for (std::size_t index = 0; index < bounds.size(); ++index) {
+            GLint first[3], last[3];
+            cellRange(bounds[index], first, last);
+            for (auto z = first[2]; z <= last[2]; ++z) {
+                for (auto y = first[1]; y <= last[1]; ++y) {
+                    for (auto x = first[0]; x <= last[0]; ++x) {
+                        grid.references[fill[cellIndex(x, y, z)]++] = references[index];
+                    }
+                }
+            }
+        }
+        return grid;
+    }
+}
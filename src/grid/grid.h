@@ -0,0 +1,35 @@
+#ifndef RAYTRACE_GRID_H
+#define RAYTRACE_GRID_H
+
+#include <vector>
+#include <GL/gl.h>
+#include "bvh/bvh.h"
+
+namespace dragiyski::raytrace::grid {
+    /**
+     * Uniform grid over the scene bounds, matching var/raytrace/grid.glsl.
+     * Cell (x, y, z) has index `x + resolution[0] * (y + resolution[1] * z)` and its primitives are
+     * `references[cells[index]]` up to (excluding) `references[cells[index + 1]]`.
+     * References use the encoding of the BVH (see bvh::reference_sphere).
+     */
+    struct Grid {
+        GLfloat min[3];
+        GLfloat cell_size[3];
+        GLint resolution[3];
+        std::vector<GLuint> cells;
+        std::vector<GLuint> references;
+    };
+
+    /**
+     * Maximum number of cells along one axis.
+     */
+    constexpr GLint max_resolution = 256;
+
+    /**
+     * Builds a grid with about `density` cells per primitive, shaped to the scene so that the cells are close to cubes.
+     * A primitive is referenced from every cell its bounds overlap.
+     */
+    Grid build(const std::vector<bvh::Bounds> &bounds, const std::vector<GLuint> &references, GLfloat density);
+}
+
+#endif //RAYTRACE_GRID_H
@@ -1,12 +1,18 @@
 #include <iostream>
 #include <stdexcept>
 #include "global.h"
+#include "options.h"
 #include "Screen.h"
 
 int main(int argc, char *argv[]) {
     using namespace dragiyski::raytrace;
-    Screen::New("Raytrace");
     try {
+        auto options = Options::parse(argc, argv);
+        auto screen = Screen::New("Raytrace", options);
+        if (options.benchmark_frames > 0) {
+            screen->benchmark(options.benchmark_frames);
+            return 0;
+        }
         if (SDL_Init(SDL_INIT_EVENTS) < 0) {
             throw sdl_error(SDL_GetError());
         }
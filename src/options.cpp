@@ -0,0 +1,159 @@
+#include "options.h"
+#include <stdexcept>
+#include <string>
+#include "scene/meshlet.h"
+
+namespace dragiyski::raytrace {
+    namespace {
+        std::size_t parseSize(const std::string &name, const char *value) {
+            try {
+                std::size_t length;
+                auto result = std::stoull(value, &length);
+                if (value[length] == '\0') {
+                    return result;
+                }
+            } catch (const std::logic_error &) {
+            }
+            throw std::invalid_argument("Invalid value for " + name + ": " + value);
+        }
+
+        float parseFloat(const std::string &name, const char *value) {
+            try {
+                std::size_t length;
+                auto result = std::stof(value, &length);
+                if (value[length] == '\0' && result >= 0.0f) {
+                    return result;
+                }
+            } catch (const std::logic_error &) {
+            }
+            throw std::invalid_argument("Invalid value for " + name + ": " + value);
+        }
+    }
+
+    Options Options::parse(int argc, char *argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string name = argv[i];
+            auto value = [&]() -> const char * {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("Missing value for " + name);
+                }
+                return argv[++i];
+            };
+            if (name == "--brute-force-threshold") {
+                options.brute_force_threshold = parseSize(name, value());
+            } else if (name == "--accelerator") {
+                std::string accelerator = value();
+                if (accelerator == "auto") {
+                    options.accelerator = AcceleratorKind::automatic;
+                } else if (accelerator == "bvh") {
+                    options.accelerator = AcceleratorKind::bvh;
+                } else if (accelerator == "grid") {
+                    options.accelerator = AcceleratorKind::grid;
+                } else if (accelerator == "brute") {
+                    options.accelerator = AcceleratorKind::brute;
+                } else if (accelerator == "stream") {
+                    options.accelerator = AcceleratorKind::stream;
+                } else if (accelerator == "meshlet") {
+                    options.accelerator = AcceleratorKind::meshlet;
+                } else {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + accelerator);
+                }
+            } else if (name == "--grid-density") {
+                options.grid_density = parseFloat(name, value());
+                if (options.grid_density == 0.0f) {
+                    throw std::invalid_argument("Invalid value for " + name + ": 0");
+                }
+            } else if (name == "--traversal") {
+                std::string traversal = value();
+                if (traversal == "stack") {
+                    options.traversal = Traversal::stack;
+                } else if (traversal == "stackless") {
+                    options.traversal = Traversal::stackless;
+                } else {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + traversal);
+                }
+            } else if (name == "--bvh-build") {
+                std::string build = value();
+                if (build == "sah") {
+                    options.bvh_build = BvhBuild::sah;
+                } else if (build == "sbvh") {
+                    options.bvh_build = BvhBuild::sbvh;
+                } else {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + build);
+                }
+            } else if (name == "--sbvh-alpha") {
+                options.sbvh_alpha = parseFloat(name, value());
+            } else if (name == "--bvh-order") {
+                std::string order = value();
+                if (order == "dfs") {
+                    options.bvh_order = bvh::Order::depth_first;
+                } else if (order == "veb") {
+                    options.bvh_order = bvh::Order::van_emde_boas;
+                } else if (order == "treelet") {
+                    options.bvh_order = bvh::Order::treelet;
+                } else {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + order);
+                }
+            } else if (name == "--stream-pool") {
+                options.stream_pool = parseSize(name, value());
+            } else if (name == "--cluster-size") {
+                options.cluster_size = parseSize(name, value());
+                if (options.cluster_size == 0) {
+                    throw std::invalid_argument("Invalid value for " + name + ": 0");
+                }
+            } else if (name == "--meshlet-size") {
+                options.meshlet_size = parseSize(name, value());
+                if (options.meshlet_size == 0 || options.meshlet_size > scene::meshlet_max_triangles) {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + std::to_string(options.meshlet_size));
+                }
+            } else if (name == "--primary") {
+                std::string primary = value();
+                if (primary == "trace") {
+                    options.primary = PrimaryRays::trace;
+                } else if (primary == "raster") {
+                    options.primary = PrimaryRays::raster;
+                } else if (primary == "binned") {
+                    options.primary = PrimaryRays::binned;
+                } else {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + primary);
+                }
+            } else if (name == "--pipeline") {
+                std::string pipeline = value();
+                if (pipeline == "deferred") {
+                    options.pipeline = Pipeline::deferred;
+                } else if (pipeline == "fused") {
+                    options.pipeline = Pipeline::fused;
+                } else {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + pipeline);
+                }
+            } else if (name == "--scene") {
+                options.scene = value();
+            } else if (name == "--quantize") {
+                options.quantize = true;
+            } else if (name == "--map-populate") {
+                options.map_populate = true;
+            } else if (name == "--benchmark") {
+                options.benchmark_frames = static_cast<unsigned>(parseSize(name, value()));
+            } else {
+                throw std::invalid_argument("Unknown option: " + name);
+            }
+        }
+        if (options.quantize && options.accelerator == AcceleratorKind::stream) {
+            // Cluster trees are built from the full precision vertices the slots hold.
+            throw std::invalid_argument("--quantize cannot be combined with --accelerator stream");
+        }
+        if (options.primary != PrimaryRays::trace &&
+            (options.accelerator == AcceleratorKind::stream || options.accelerator == AcceleratorKind::meshlet)) {
+            // Rasterizing and binning read the triangles of the scene, which are only on the GPU with the other
+            // accelerators.
+            throw std::invalid_argument("--primary raster or binned cannot be combined with --accelerator stream or meshlet");
+        }
+        if (options.pipeline == Pipeline::fused &&
+            (options.primary != PrimaryRays::trace || options.accelerator == AcceleratorKind::stream)) {
+            // The fused kernel traces its primary ray in one go; the other primary modes and streaming are passes.
+            throw std::invalid_argument("--pipeline fused requires --primary trace and cannot be combined with --accelerator stream");
+        }
+        return options;
+    }
+}
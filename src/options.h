@@ -0,0 +1,147 @@
+#ifndef RAYTRACE_OPTIONS_H
+#define RAYTRACE_OPTIONS_H
+
+#include <cstddef>
+#include <filesystem>
+#include "bvh/bvh.h"
+
+namespace dragiyski::raytrace {
+    /**
+     * BVH traversal used by the trace and shadow kernels.
+     */
+    enum class Traversal {
+        // Near-first traversal with a per-invocation stack of deferred children.
+        stack,
+        // Depth-first walk over miss (skip) links, no stack.
+        stackless
+    };
+
+    /**
+     * Acceleration structure of the tracing kernels.
+     */
+    enum class AcceleratorKind {
+        // Brute force for scenes up to the brute force threshold, a BVH otherwise.
+        automatic,
+        bvh,
+        // Uniform grid: good for uniformly dense scenes, like particle fields.
+        grid,
+        brute,
+        // Out-of-core: clusters of the geometry are paged into a fixed GPU pool as rays reach them.
+        stream,
+        // BVH over meshlets: less index memory than the triangles of the scene and a bounds test per meshlet.
+        meshlet
+    };
+
+    /**
+     * How the closest hits of camera rays are found.
+     */
+    enum class PrimaryRays {
+        // Traced through the acceleration structure, like every other ray.
+        trace,
+        // Rasterized into a visibility buffer of primitive ids; each pixel then intersects only its visible primitive.
+        raster,
+        // Primitives are binned to the screen tiles they project to; each pixel then intersects the list of its tile.
+        binned
+    };
+
+    /**
+     * How a frame goes from primary hits to pixels.
+     */
+    enum class Pipeline {
+        // Primary hits are written to the G-buffer, then shadow rays and lighting read them back in their own passes.
+        deferred,
+        // One kernel traces the primary and the shadow ray of a pixel and shades it, without the G-buffer.
+        fused
+    };
+
+    /**
+     * BVH construction.
+     */
+    enum class BvhBuild {
+        // Binned SAH over object splits, fast enough for every launch.
+        sah,
+        // Binned SAH with spatial splits: better trees for long, thin or overlapping primitives, but a slower build.
+        sbvh
+    };
+
+    /**
+     * Command line options of the renderer.
+     */
+    struct Options {
+        /**
+         * Scenes with at most this many primitives (triangles and spheres) are traced brute force, batched through
+         * shared memory, instead of traversing the BVH. With --primary binned, the same holds for each screen tile.
+         */
+        std::size_t brute_force_threshold = 256;
+
+        AcceleratorKind accelerator = AcceleratorKind::automatic;
+
+        /**
+         * Cells per primitive of the grid accelerator.
+         */
+        float grid_density = 4.0f;
+
+        Traversal traversal = Traversal::stack;
+
+        BvhBuild bvh_build = BvhBuild::sah;
+
+        /**
+         * Spatial splits are tried where children of an object split overlap by more than this fraction of the scene
+         * surface area.
+         */
+        float sbvh_alpha = 1e-5f;
+
+        /**
+         * Node order of the tree used by the stack traversal. The stackless tree is always depth first.
+         */
+        bvh::Order bvh_order = bvh::Order::depth_first;
+
+        /**
+         * GPU memory for resident clusters of the stream accelerator, in MiB.
+         */
+        std::size_t stream_pool = 256;
+
+        /**
+         * Primitives per cluster, when the scene does not come with clusters.
+         */
+        std::size_t cluster_size = 4096;
+
+        /**
+         * Triangles per meshlet (at most 256), when the scene does not come with meshlets.
+         */
+        std::size_t meshlet_size = 128;
+
+        PrimaryRays primary = PrimaryRays::trace;
+
+        Pipeline pipeline = Pipeline::deferred;
+
+        /**
+         * When non-zero, render this many frames with every accelerator, traversal and node order, and with both
+         * pipelines where they apply, print their statistics and exit.
+         */
+        unsigned benchmark_frames = 0;
+
+        /**
+         * Upload vertices in the 16-byte quantized layout (see scene/quantize.h) instead of 32-byte floats. Trees are
+         * then built from the quantized positions, never taken from the scene file. Not available with streaming.
+         */
+        bool quantize = false;
+
+        /**
+         * Read the mapped scene files completely while loading (MAP_POPULATE), instead of on first access.
+         */
+        bool map_populate = false;
+
+        /**
+         * Scene to render, relative to the project directory unless absolute: a JSON scene description (see
+         * scene/description.h), or a single mesh with the default view: a scene container (.rtscene), a glTF asset
+         * (.gltf, .glb), an OBJ or PLY mesh, or the prefix of raw mesh buffers (.vbo.bin, .ibo.bin). A single mesh that
+         * is not a container takes its spheres from var/models/spheres.bin.
+         */
+        std::filesystem::path scene = "var/scenes/default.json";
+
+        static Options parse(int argc, char *argv[]);
+    };
+}
+
+#endif //RAYTRACE_OPTIONS_H
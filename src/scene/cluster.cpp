@@ -0,0 +1,105 @@
+#include "cluster.h"
+#include <algorithm>
+#include <limits>
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        constexpr GLuint unused = std::numeric_limits<GLuint>::max();
+    }
+
+    Clusters buildClusters(Scene &scene, const bvh::Tree &tree, std::size_t max_primitives) {
+        if (tree.references.empty()) {
+            return {};
+        }
+        std::vector<Cluster> table;
+        std::vector<Vertex> vertices;
+        std::vector<Triangle> triangles;
+        std::vector<bvh::Node> nodes;
+        std::vector<GLuint> references;
+
+        auto sizes = bvh::subtreeSizes(tree);
+        std::vector<GLuint> roots;
+        std::vector<GLuint> stack = {0};
+        while (!stack.empty()) {
+            auto index = stack.back();
+            stack.pop_back();
+            const auto &node = tree.nodes[index];
+            if (node.count > 0 || sizes[index] <= max_primitives) {
+                roots.push_back(index);
+            } else {
+                stack.push_back(node.first + 1);
+                stack.push_back(node.first);
+            }
+        }
+
+        // Index of a scene vertex in the current cluster.
+        std::vector<GLuint> localVertex(scene.vertexCount(), unused);
+        std::vector<GLuint> used;
+        for (auto root : roots) {
+            Cluster cluster{};
+            const auto &rootNode = tree.nodes[root];
+            std::copy(std::begin(rootNode.min), std::end(rootNode.min), cluster.min);
+            std::copy(std::begin(rootNode.max), std::end(rootNode.max), cluster.max);
+            cluster.vertex_offset = static_cast<GLuint>(vertices.size());
+            cluster.triangle_offset = static_cast<GLuint>(triangles.size());
+            cluster.node_offset = static_cast<GLuint>(nodes.size());
+            cluster.reference_offset = static_cast<GLuint>(references.size());
+
+            // The subtree is copied in the layout of bvh::build: siblings are adjacent and follow their parent.
+            std::vector<std::pair<GLuint, GLuint>> pending = {{root, 0}};
+            nodes.push_back(rootNode);
+            while (!pending.empty()) {
+                auto [source, target] = pending.back();
+                pending.pop_back();
+                const auto &node = tree.nodes[source];
+                auto &copy = nodes[cluster.node_offset + target];
+                if (node.count == 0) {
+                    auto left = static_cast<GLuint>(nodes.size() - cluster.node_offset);
+                    copy.first = left;
+                    nodes.push_back(tree.nodes[node.first]);
+                    nodes.push_back(tree.nodes[node.first + 1]);
+                    pending.emplace_back(node.first + 1, left + 1);
+                    pending.emplace_back(node.first, left);
+                    continue;
+                }
+                copy.first = static_cast<GLuint>(references.size() - cluster.reference_offset);
+                for (auto reference : std::span(tree.references).subspan(node.first, node.count)) {
+                    if ((reference & bvh::reference_sphere) != 0) {
+                        references.push_back(reference);
+                        continue;
+                    }
+                    Triangle triangle{};
+                    for (std::size_t corner = 0; corner < 3; ++corner) {
+                        auto vertex = scene.triangles[reference][corner];
+                        if (localVertex[vertex] == unused) {
+                            localVertex[vertex] = static_cast<GLuint>(vertices.size() - cluster.vertex_offset);
+                            used.push_back(vertex);
+                            vertices.push_back(scene.vertex(vertex));
+                        }
+                        triangle[corner] = localVertex[vertex];
+                    }
+                    references.push_back(static_cast<GLuint>(triangles.size() - cluster.triangle_offset));
+                    triangles.push_back(triangle);
+                }
+            }
+
+            cluster.vertex_count = static_cast<GLuint>(vertices.size() - cluster.vertex_offset);
+            cluster.triangle_count = static_cast<GLuint>(triangles.size() - cluster.triangle_offset);
+            cluster.node_count = static_cast<GLuint>(nodes.size() - cluster.node_offset);
+            cluster.reference_count = static_cast<GLuint>(references.size() - cluster.reference_offset);
+            for (auto vertex : used) {
+                localVertex[vertex] = unused;
+            }
+            used.clear();
+            table.push_back(cluster);
+        }
+
+        Clusters result;
+        result.table = scene.own(std::move(table));
+        result.vertices = scene.own(std::move(vertices));
+        result.triangles = scene.own(std::move(triangles));
+        result.nodes = scene.own(std::move(nodes));
+        result.references = scene.own(std::move(references));
+        return result;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef RAYTRACE_CLUSTER_H
+#define RAYTRACE_CLUSTER_H
+
+#include <cstddef>
+#include "scene.h"
+
+namespace dragiyski::raytrace::scene {
+    /**
+     * Splits the scene into clusters of at most `max_primitives` references: the largest subtrees of `tree` (a BVH over
+     * the primitives of `scene`, see Scene::references) that are small enough. Each cluster keeps its subtree, with
+     * local node and triangle indices, and copies of the vertices it uses. A leaf larger than the limit becomes a
+     * cluster of its own. The arrays are owned by `scene`.
+     */
+    Clusters buildClusters(Scene &scene, const bvh::Tree &tree, std::size_t max_primitives);
+}
+
+#endif //RAYTRACE_CLUSTER_H
@@ -0,0 +1,278 @@
+#include "container.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "mapped_file.h"
+#include "meshlet.h"
+
+namespace dragiyski::raytrace::scene::container {
+    namespace {
+        std::uint64_t align(std::uint64_t offset) {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        struct Source {
+            std::uint32_t tag;
+            std::uint32_t flags;
+            const void *data;
+            std::uint64_t size;
+            // Writes the chunk instead of `data`, for chunks produced while writing.
+            std::function<void(std::ofstream &)> produce;
+        };
+
+        template<typename T>
+        Source source(std::uint32_t tag, std::span<const T> data, std::uint32_t flags = 0) {
+            return {tag, flags, data.data(), data.size_bytes(), nullptr};
+        }
+
+        // One of the two streams of interleaved `vertices`, `Stream` being Position or Attributes.
+        template<typename Stream>
+        Source split(std::uint32_t tag, std::span<const Vertex> vertices) {
+            return {tag, 0, nullptr, vertices.size() * sizeof(Stream), [vertices](std::ofstream &file) {
+                splitVertices(vertices, [&](std::size_t, std::span<const Position> positions, std::span<const Attributes> attributes) {
+                    std::span<const Stream> batch;
+                    if constexpr (std::is_same_v<Stream, Position>) {
+                        batch = positions;
+                    } else {
+                        batch = attributes;
+                    }
+                    file.write(reinterpret_cast<const char *>(batch.data()), static_cast<std::streamsize>(batch.size_bytes()));
+                });
+            }};
+        }
+
+        bool validReferences(std::span<const GLuint> references, std::uint64_t triangle_count, std::uint64_t sphere_count) {
+            return std::all_of(references.begin(), references.end(), [&](GLuint reference) {
+                return (reference & bvh::reference_index) < ((reference & bvh::reference_sphere) != 0 ? sphere_count : triangle_count);
+            });
+        }
+
+        // Children of interior nodes and the references of leaves are in range; the traversal follows them unchecked.
+        // Children also follow their parent, as bvh::build lays them out, and have no other parent, so the nodes form a
+        // tree. Its depth is limited to bvh::max_depth, which is the traversal stack size in the shaders.
+        bool validNodes(std::span<const bvh::Node> nodes, std::uint64_t reference_count) {
+            // With children after their parent, a single forward pass sees every parent before its children.
+            std::vector<unsigned> depth(nodes.size(), 0);
+            std::vector<bool> reached(nodes.size(), false);
+            for (std::size_t index = 0; index < nodes.size(); ++index) {
+                const auto &node = nodes[index];
+                if (node.count != 0) {
+                    if (std::uint64_t(node.first) + node.count > reference_count) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (node.first <= index || std::uint64_t(node.first) + 1 >= nodes.size() || depth[index] >= bvh::max_depth) {
+                    return false;
+                }
+                for (auto child : {node.first, node.first + 1}) {
+                    if (reached[child]) {
+                        return false;
+                    }
+                    reached[child] = true;
+                    depth[child] = depth[index] + 1;
+                }
+            }
+            return true;
+        }
+
+        template<typename T>
+        std::span<const T> view(const MappedFile &file, const Chunk &chunk, const std::filesystem::path &path) {
+            if (chunk.size % sizeof(T) != 0) {
+                throw std::runtime_error("Invalid chunk size in " + path.string());
+            }
+            auto data = static_cast<const char *>(file.data()) + chunk.offset;
+            return {reinterpret_cast<const T *>(data), chunk.size / sizeof(T)};
+        }
+    }
+
+    bool isContainer(const std::filesystem::path &path) {
+        return path.extension() == extension;
+    }
+
+    void write(const std::filesystem::path &path, const Scene &scene) {
+        std::vector<Source> sources;
+        if (scene.vertices.empty()) {
+            sources.push_back(source(tag_positions, scene.positions));
+            sources.push_back(source(tag_attributes, scene.attributes));
+        } else {
+            sources.push_back(split<Position>(tag_positions, scene.vertices));
+            sources.push_back(split<Attributes>(tag_attributes, scene.vertices));
+        }
+        sources.push_back(source(tag_triangles, scene.triangles));
+        sources.push_back(source(tag_spheres, scene.spheres));
+        if (!scene.bvh.nodes.empty()) {
+            sources.push_back(source(tag_bvh_nodes, std::span<const bvh::Node>(scene.bvh.nodes), scene.bvh_spatial ? flag_bvh_spatial : 0));
+            sources.push_back(source(tag_bvh_references, std::span<const GLuint>(scene.bvh.references)));
+        }
+        if (!scene.clusters.table.empty()) {
+            sources.push_back(source(tag_clusters, scene.clusters.table));
+            sources.push_back(source(tag_cluster_vertices, scene.clusters.vertices));
+            sources.push_back(source(tag_cluster_triangles, scene.clusters.triangles));
+            sources.push_back(source(tag_cluster_nodes, scene.clusters.nodes));
+            sources.push_back(source(tag_cluster_references, scene.clusters.references));
+        }
+        if (!scene.meshlets.table.empty()) {
+            sources.push_back(source(tag_meshlets, scene.meshlets.table));
+            sources.push_back(source(tag_meshlet_data, scene.meshlets.data));
+        }
+
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.chunk_count = static_cast<std::uint32_t>(sources.size());
+        std::vector<Chunk> chunks;
+        auto offset = align(sizeof(Header) + sources.size() * sizeof(Chunk));
+        for (const auto &chunk : sources) {
+            chunks.push_back({chunk.tag, chunk.flags, offset, chunk.size});
+            offset = align(offset + chunk.size);
+        }
+
+        std::ofstream file;
+        file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        file.open(path, std::ofstream::binary | std::ofstream::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(Chunk)));
+        const char padding[alignment] = {};
+        std::uint64_t position = sizeof(Header) + chunks.size() * sizeof(Chunk);
+        for (std::size_t index = 0; index < sources.size(); ++index) {
+            file.write(padding, static_cast<std::streamsize>(chunks[index].offset - position));
+            if (sources[index].produce) {
+                sources[index].produce(file);
+            } else {
+                file.write(static_cast<const char *>(sources[index].data), static_cast<std::streamsize>(sources[index].size));
+            }
+            position = chunks[index].offset + chunks[index].size;
+        }
+        // The file ends aligned as well, so chunks can later be appended without moving anything.
+        file.write(padding, static_cast<std::streamsize>(align(position) - position));
+    }
+
+    Scene read(const std::filesystem::path &path, bool populate) {
+        auto file = std::make_shared<const MappedFile>(path, populate);
+        Header header{};
+        if (file->size() < sizeof(Header)) {
+            throw std::runtime_error("Not a scene container: " + path.string());
+        }
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Not a scene container: " + path.string());
+        }
+        if (header.version < 1 || header.version > version) {
+            throw std::runtime_error("Unsupported scene container version " + std::to_string(header.version) + ": " + path.string());
+        }
+        if (file->size() < sizeof(Header) + std::uint64_t(header.chunk_count) * sizeof(Chunk)) {
+            throw std::runtime_error("Truncated scene container: " + path.string());
+        }
+        auto chunks = reinterpret_cast<const Chunk *>(static_cast<const char *>(file->data()) + sizeof(Header));
+
+        Scene scene;
+        scene.storage.push_back(file);
+        for (std::uint32_t index = 0; index < header.chunk_count; ++index) {
+            const auto &chunk = chunks[index];
+            if (chunk.offset % alignment != 0 || chunk.offset > file->size() || chunk.size > file->size() - chunk.offset) {
+                throw std::runtime_error("Invalid chunk in " + path.string());
+            }
+            switch (chunk.tag) {
+                case tag_vertices:
+                    scene.vertices = view<Vertex>(*file, chunk, path);
+                    break;
+                case tag_positions:
+                    scene.positions = view<Position>(*file, chunk, path);
+                    break;
+                case tag_attributes:
+                    scene.attributes = view<Attributes>(*file, chunk, path);
+                    break;
+                case tag_triangles:
+                    scene.triangles = view<Triangle>(*file, chunk, path);
+                    break;
+                case tag_spheres:
+                    scene.spheres = view<Sphere>(*file, chunk, path);
+                    break;
+                case tag_bvh_nodes: {
+                    auto nodes = view<bvh::Node>(*file, chunk, path);
+                    scene.bvh.nodes.assign(nodes.begin(), nodes.end());
+                    scene.bvh_spatial = (chunk.flags & flag_bvh_spatial) != 0;
+                    break;
+                }
+                case tag_bvh_references: {
+                    auto references = view<GLuint>(*file, chunk, path);
+                    scene.bvh.references.assign(references.begin(), references.end());
+                    break;
+                }
+                case tag_clusters:
+                    scene.clusters.table = view<Cluster>(*file, chunk, path);
+                    break;
+                case tag_cluster_vertices:
+                    scene.clusters.vertices = view<Vertex>(*file, chunk, path);
+                    break;
+                case tag_cluster_triangles:
+                    scene.clusters.triangles = view<Triangle>(*file, chunk, path);
+                    break;
+                case tag_cluster_nodes:
+                    scene.clusters.nodes = view<bvh::Node>(*file, chunk, path);
+                    break;
+                case tag_cluster_references:
+                    scene.clusters.references = view<GLuint>(*file, chunk, path);
+                    break;
+                case tag_meshlets:
+                    scene.meshlets.table = view<Meshlet>(*file, chunk, path);
+                    break;
+                case tag_meshlet_data:
+                    scene.meshlets.data = view<GLuint>(*file, chunk, path);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (scene.positions.size() != scene.attributes.size() || (!scene.vertices.empty() && !scene.positions.empty())) {
+            throw std::runtime_error("Invalid vertices in " + path.string());
+        }
+        // Indices are used by the kernels as they are, so everything they reach is checked once here.
+        if (!validTriangles(scene.triangles, scene.vertexCount())) {
+            throw std::runtime_error("Invalid triangle in " + path.string());
+        }
+        if (scene.bvh.nodes.empty() != scene.bvh.references.empty() && scene.primitiveCount() > 0) {
+            throw std::runtime_error("Incomplete BVH in " + path.string());
+        }
+        if (!validNodes(scene.bvh.nodes, scene.bvh.references.size()) ||
+            !validReferences(scene.bvh.references, scene.triangles.size(), scene.spheres.size())) {
+            throw std::runtime_error("Invalid BVH in " + path.string());
+        }
+        for (const auto &cluster : scene.clusters.table) {
+            if (std::uint64_t(cluster.vertex_offset) + cluster.vertex_count > scene.clusters.vertices.size() ||
+                std::uint64_t(cluster.triangle_offset) + cluster.triangle_count > scene.clusters.triangles.size() ||
+                std::uint64_t(cluster.node_offset) + cluster.node_count > scene.clusters.nodes.size() ||
+                std::uint64_t(cluster.reference_offset) + cluster.reference_count > scene.clusters.references.size() ||
+                cluster.node_count == 0 ||
+                !validTriangles(scene.clusters.triangles.subspan(cluster.triangle_offset, cluster.triangle_count), cluster.vertex_count) ||
+                !validNodes(scene.clusters.nodes.subspan(cluster.node_offset, cluster.node_count), cluster.reference_count) ||
+                !validReferences(scene.clusters.references.subspan(cluster.reference_offset, cluster.reference_count), cluster.triangle_count, scene.spheres.size())) {
+                throw std::runtime_error("Invalid cluster in " + path.string());
+            }
+        }
+        for (const auto &meshlet : scene.meshlets.table) {
+            if (std::uint64_t(meshlet.offset) + meshlet.vertex_count + meshlet.triangle_count > scene.meshlets.data.size() ||
+                meshlet.vertex_count > meshlet_max_vertices || meshlet.triangle_count > meshlet_max_triangles ||
+                meshlet.triangle_count == 0) {
+                throw std::runtime_error("Invalid meshlet in " + path.string());
+            }
+            auto vertices = scene.meshlets.data.subspan(meshlet.offset, meshlet.vertex_count);
+            auto triangles = scene.meshlets.data.subspan(meshlet.offset + meshlet.vertex_count, meshlet.triangle_count);
+            if (std::any_of(vertices.begin(), vertices.end(), [&](GLuint vertex) { return vertex >= scene.vertexCount(); }) ||
+                std::any_of(triangles.begin(), triangles.end(), [&](GLuint corners) {
+                    return (corners & 0xFF) >= meshlet.vertex_count || (corners >> 8 & 0xFF) >= meshlet.vertex_count || (corners >> 16 & 0xFF) >= meshlet.vertex_count;
+                })) {
+                throw std::runtime_error("Invalid meshlet in " + path.string());
+            }
+        }
+        if (scene.meshlets.table.size() > meshlet_max_count) {
+            throw std::runtime_error("Too many meshlets in " + path.string());
+        }
+        return scene;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef RAYTRACE_CONTAINER_H
+#define RAYTRACE_CONTAINER_H
+
+#include <cstdint>
+#include <filesystem>
+#include "scene.h"
+
+/**
+ * Scene container (.rtscene): every array of a scene in one file, laid out so that it is used straight from a mapping.
+ *
+ * The file starts with a Header, followed by `chunk_count` Chunk entries. Each chunk is a tightly packed array of the
+ * type its tag names, in the layout of the CPU struct (and so of the GPU buffers), little endian. Chunk data starts at
+ * a multiple of `alignment` bytes from the start of the file. Readers skip chunks with unknown tags, so new chunks do
+ * not need a new version; a change to an existing layout does.
+ */
+namespace dragiyski::raytrace::scene::container {
+    constexpr char extension[] = ".rtscene";
+    constexpr char magic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+    // Version 1 stored the vertices interleaved (VERT); version 2 stores them as the VPOS and VATR streams. Both read.
+    constexpr std::uint32_t version = 2;
+    constexpr std::uint64_t alignment = 64;
+
+    constexpr std::uint32_t tag(const char (&name)[5]) {
+        return std::uint32_t(name[0]) | std::uint32_t(name[1]) << 8 | std::uint32_t(name[2]) << 16 | std::uint32_t(name[3]) << 24;
+    }
+
+    // Vertex[], only in version 1 files.
+    constexpr std::uint32_t tag_vertices = tag("VERT");
+    // Position[] and Attributes[] of the vertices, the buffers the kernels read.
+    constexpr std::uint32_t tag_positions = tag("VPOS");
+    constexpr std::uint32_t tag_attributes = tag("VATR");
+    // Triangle[]: three vertex indices each.
+    constexpr std::uint32_t tag_triangles = tag("TRIS");
+    // Sphere[]
+    constexpr std::uint32_t tag_spheres = tag("SPHR");
+    // Reserved for materials and instances, which the scene model does not have yet.
+    constexpr std::uint32_t tag_materials = tag("MATL");
+    constexpr std::uint32_t tag_instances = tag("INST");
+    // bvh::Node[] in build order; `flags` is `flag_bvh_spatial` for a tree built with spatial splits.
+    constexpr std::uint32_t tag_bvh_nodes = tag("BVHN");
+    // GLuint[] of BVH references (see bvh::reference_sphere).
+    constexpr std::uint32_t tag_bvh_references = tag("BVHR");
+    // Clusters (see cluster.h): Cluster[] and the arrays it indexes, Vertex[], Triangle[], bvh::Node[] and GLuint[].
+    constexpr std::uint32_t tag_clusters = tag("CLUS");
+    constexpr std::uint32_t tag_cluster_vertices = tag("CVRT");
+    constexpr std::uint32_t tag_cluster_triangles = tag("CTRI");
+    constexpr std::uint32_t tag_cluster_nodes = tag("CNOD");
+    constexpr std::uint32_t tag_cluster_references = tag("CREF");
+    // Meshlets (see meshlet.h): Meshlet[] and the GLuint[] it indexes.
+    constexpr std::uint32_t tag_meshlets = tag("MSHL");
+    constexpr std::uint32_t tag_meshlet_data = tag("MDAT");
+
+    constexpr std::uint32_t flag_bvh_spatial = 1;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t chunk_count;
+    };
+
+    struct Chunk {
+        std::uint32_t tag;
+        std::uint32_t flags;
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    [[nodiscard]] bool isContainer(const std::filesystem::path &path);
+
+    /**
+     * Writes the scene, with its `bvh`, `clusters` and `meshlets` when they are not empty. Interleaved vertices are
+     * split into the two streams while writing, a batch at a time.
+     */
+    void write(const std::filesystem::path &path, const Scene &scene);
+
+    /**
+     * Maps a container. The arrays of the scene, its clusters and meshlets point into the mapping, only the tree is copied.
+     * Every index is checked against the array it points into; a file that fails is rejected with std::runtime_error.
+     */
+    Scene read(const std::filesystem::path &path, bool populate = false);
+}
+
+#endif //RAYTRACE_CONTAINER_H
@@ -0,0 +1,121 @@
+#include "description.h"
+#include <fstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+#include "global.h"
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        using json = nlohmann::json;
+
+        template<std::size_t N>
+        void readVector(const json &object, const char *name, GLfloat (&target)[N]) {
+            if (!object.contains(name)) {
+                return;
+            }
+            auto values = object[name].get<std::vector<GLfloat>>();
+            if (values.size() != N) {
+                throw std::runtime_error(std::string("Invalid scene: \"") + name + "\" needs " + std::to_string(N) + " components");
+            }
+            std::copy(values.begin(), values.end(), target);
+        }
+
+        void readScalar(const json &object, const char *name, GLfloat &target) {
+            target = object.value(name, target);
+        }
+
+        std::filesystem::path resolve(const std::filesystem::path &base, const std::string &path) {
+            return std::filesystem::resolve(std::filesystem::path(path), base);
+        }
+    }
+
+    bool isDescription(const std::filesystem::path &path) {
+        return path.extension() == ".json";
+    }
+
+    Description describe(const std::filesystem::path &path, const std::filesystem::path &spheres) {
+        Description description;
+        if (!isDescription(path)) {
+            description.meshes.push_back(path);
+            description.spheres = spheres;
+            return description;
+        }
+
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error("File not found: " + path.string());
+        }
+        json root;
+        try {
+            root = json::parse(file);
+        } catch (const json::exception &e) {
+            throw std::runtime_error("Invalid scene " + path.string() + ": " + e.what());
+        }
+        auto base = path.parent_path();
+        auto object = [&root](const char *name) {
+            return root.contains(name) ? root[name] : json::object();
+        };
+        auto camera = object("camera");
+        readVector(camera, "origin", description.camera.origin);
+        readVector(camera, "direction", description.camera.direction);
+        readScalar(camera, "roll", description.camera.roll);
+        readScalar(camera, "fov", description.camera.field_of_view);
+        auto light = object("light");
+        readVector(light, "position", description.light.position);
+        readVector(light, "color", description.light.color);
+        auto material = object("material");
+        readScalar(material, "ambient", description.material.ambient);
+        readScalar(material, "diffuse", description.material.diffuse);
+        readScalar(material, "specular", description.material.specular);
+        readScalar(material, "shininess", description.material.shininess);
+        readVector(material, "color", description.material.color);
+        for (const auto &mesh : root.value("meshes", json::array())) {
+            description.meshes.push_back(resolve(base, mesh.get<std::string>()));
+        }
+        if (root.contains("spheres")) {
+            description.spheres = resolve(base, root["spheres"].get<std::string>());
+        }
+        if (description.camera.field_of_view <= 0.0f || description.camera.field_of_view >= 180.0f) {
+            throw std::runtime_error("Invalid scene " + path.string() + ": the field of view must be between 0 and 180 degrees");
+        }
+        return description;
+    }
+
+    Scene open(const Description &description, bool populate) {
+        if (description.meshes.empty()) {
+            throw std::runtime_error("Scene without meshes");
+        }
+        if (description.meshes.size() == 1) {
+            return open(description.meshes[0], description.spheres, populate);
+        }
+        // The merged vertices are built as the two streams the kernels read, so they are uploaded without a split.
+        std::vector<Position> positions;
+        std::vector<Attributes> attributes;
+        std::vector<Triangle> triangles;
+        std::vector<Sphere> spheres;
+        for (std::size_t index = 0; index < description.meshes.size(); ++index) {
+            // The spheres come with the first mesh only, so they are not repeated.
+            auto part = open(description.meshes[index], index == 0 ? description.spheres : std::filesystem::path(), populate);
+            auto base = static_cast<GLuint>(positions.size());
+            if (part.vertices.empty()) {
+                positions.insert(positions.end(), part.positions.begin(), part.positions.end());
+                attributes.insert(attributes.end(), part.attributes.begin(), part.attributes.end());
+            } else {
+                splitVertices(part.vertices, [&](std::size_t, std::span<const Position> batchPositions, std::span<const Attributes> batchAttributes) {
+                    positions.insert(positions.end(), batchPositions.begin(), batchPositions.end());
+                    attributes.insert(attributes.end(), batchAttributes.begin(), batchAttributes.end());
+                });
+            }
+            for (auto triangle : part.triangles) {
+                triangles.push_back({triangle[0] + base, triangle[1] + base, triangle[2] + base});
+            }
+            spheres.insert(spheres.end(), part.spheres.begin(), part.spheres.end());
+        }
+        Scene scene;
+        scene.positions = scene.own(std::move(positions));
+        scene.attributes = scene.own(std::move(attributes));
+        scene.triangles = scene.own(std::move(triangles));
+        scene.spheres = scene.own(std::move(spheres));
+        return scene;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef RAYTRACE_DESCRIPTION_H
+#define RAYTRACE_DESCRIPTION_H
+
+#include <filesystem>
+#include <vector>
+#include <GL/gl.h>
+#include "scene.h"
+
+namespace dragiyski::raytrace::scene {
+    /**
+     * Pinhole camera. Camera space looks down `direction` with the world y axis up, rolled around the direction by
+     * `roll` degrees. `field_of_view` is the angle, in degrees, between opposite corners of the image.
+     */
+    struct Camera {
+        GLfloat origin[3] = {0.0f, 0.0f, 6.0f};
+        GLfloat direction[3] = {0.0f, 0.0f, -1.0f};
+        GLfloat roll = 0.0f;
+        GLfloat field_of_view = 90.0f;
+    };
+
+    struct Light {
+        GLfloat position[3] = {3.0f, 4.0f, 6.0f};
+        GLfloat color[3] = {1.0f, 1.0f, 1.0f};
+    };
+
+    /**
+     * Phong coefficients shared by every surface. Spheres have their own color, triangles use `color`.
+     */
+    struct Material {
+        GLfloat ambient = 0.15f;
+        GLfloat diffuse = 0.6f;
+        GLfloat specular = 0.25f;
+        GLfloat shininess = 8.0f;
+        GLfloat color[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    };
+
+    /**
+     * What to render: the view, the lighting and the geometry files (anything `open` reads). Every field of the JSON
+     * form is optional and defaults to the values here:
+     *
+     *     {
+     *         "camera": {"origin": [0, 0, 6], "direction": [0, 0, -1], "roll": 0, "fov": 90},
+     *         "light": {"position": [3, 4, 6], "color": [1, 1, 1]},
+     *         "material": {"ambient": 0.15, "diffuse": 0.6, "specular": 0.25, "shininess": 8, "color": [1, 1, 1, 1]},
+     *         "meshes": ["../models/cube"],
+     *         "spheres": "../models/spheres.bin"
+     *     }
+     *
+     * Paths are relative to the directory of the description.
+     */
+    struct Description {
+        Camera camera;
+        Light light;
+        Material material;
+        std::vector<std::filesystem::path> meshes;
+        std::filesystem::path spheres;
+    };
+
+    [[nodiscard]] bool isDescription(const std::filesystem::path &path);
+
+    /**
+     * Reads a JSON description (a path ending with `.json`). Any other path is a single mesh with the default view and
+     * lighting, which takes its spheres from `spheres`.
+     */
+    Description describe(const std::filesystem::path &path, const std::filesystem::path &spheres);
+
+    /**
+     * Opens the geometry of a description. A single mesh is opened as by `open`; several meshes are concatenated into
+     * owned arrays, without the prebuilt tree of any container.
+     */
+    Scene open(const Description &description, bool populate = false);
+}
+
+#endif //RAYTRACE_DESCRIPTION_H
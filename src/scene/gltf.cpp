@@ -0,0 +1,554 @@
+#include "gltf.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "mapped_file.h"
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        using json = nlohmann::json;
+
+        // Column major, like glTF.
+        using Matrix = std::array<double, 16>;
+        constexpr Matrix identity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+
+        constexpr std::uint32_t glb_magic = 0x46546C67;
+        constexpr std::uint32_t glb_chunk_json = 0x4E4F534A;
+        constexpr std::uint32_t glb_chunk_bin = 0x004E4942;
+
+        constexpr int component_byte = 5120;
+        constexpr int component_unsigned_byte = 5121;
+        constexpr int component_short = 5122;
+        constexpr int component_unsigned_short = 5123;
+        constexpr int component_unsigned_int = 5125;
+        constexpr int component_float = 5126;
+
+        constexpr int mode_triangles = 4;
+
+        [[noreturn]] void fail(const std::string &message) {
+            throw std::runtime_error("Invalid glTF: " + message);
+        }
+
+        // Array member of a glTF object, empty when it is absent. Unlike json::value, no copy is made.
+        const json &member(const json &object, const char *name) {
+            static const json empty = json::array();
+            return object.contains(name) ? object[name] : empty;
+        }
+
+        Matrix multiply(const Matrix &a, const Matrix &b) {
+            Matrix result{};
+            for (std::size_t column = 0; column < 4; ++column) {
+                for (std::size_t row = 0; row < 4; ++row) {
+                    for (std::size_t k = 0; k < 4; ++k) {
+                        result[column * 4 + row] += a[k * 4 + row] * b[column * 4 + k];
+                    }
+                }
+            }
+            return result;
+        }
+
+        Matrix nodeMatrix(const json &node) {
+            if (node.contains("matrix")) {
+                auto values = node["matrix"].get<std::vector<double>>();
+                if (values.size() != 16) {
+                    fail("node matrix");
+                }
+                Matrix result;
+                std::copy(values.begin(), values.end(), result.begin());
+                return result;
+            }
+            auto t = node.value("translation", std::vector<double>{0, 0, 0});
+            auto q = node.value("rotation", std::vector<double>{0, 0, 0, 1});
+            auto s = node.value("scale", std::vector<double>{1, 1, 1});
+            if (t.size() != 3 || q.size() != 4 || s.size() != 3) {
+                fail("node transform");
+            }
+            auto [x, y, z, w] = std::array<double, 4>{q[0], q[1], q[2], q[3]};
+            // T * R * S
+            return {
+                (1 - 2 * (y * y + z * z)) * s[0], 2 * (x * y + z * w) * s[0], 2 * (x * z - y * w) * s[0], 0,
+                2 * (x * y - z * w) * s[1], (1 - 2 * (x * x + z * z)) * s[1], 2 * (y * z + x * w) * s[1], 0,
+                2 * (x * z + y * w) * s[2], 2 * (y * z - x * w) * s[2], (1 - 2 * (x * x + y * y)) * s[2], 0,
+                t[0], t[1], t[2], 1,
+            };
+        }
+
+        std::size_t componentSize(int type) {
+            switch (type) {
+                case component_byte:
+                case component_unsigned_byte:
+                    return 1;
+                case component_short:
+                case component_unsigned_short:
+                    return 2;
+                case component_unsigned_int:
+                case component_float:
+                    return 4;
+                default:
+                    fail("component type " + std::to_string(type));
+            }
+        }
+
+        std::size_t componentCount(const std::string &type) {
+            if (type == "SCALAR") {
+                return 1;
+            }
+            if (type == "VEC2") {
+                return 2;
+            }
+            if (type == "VEC3") {
+                return 3;
+            }
+            if (type == "VEC4") {
+                return 4;
+            }
+            fail("accessor type " + type);
+        }
+
+        /**
+         * Elements of an accessor in a mapped buffer: element `i` starts at `data + i * stride`.
+         */
+        struct Accessor {
+            const char *data;
+            std::size_t count;
+            int component_type;
+            std::size_t components;
+            std::size_t stride;
+            bool normalized;
+
+            [[nodiscard]] double component(std::size_t index, std::size_t component) const {
+                auto source = data + index * stride + component * componentSize(component_type);
+                auto read = [source]<typename T>(T) {
+                    T value;
+                    std::memcpy(&value, source, sizeof(T));
+                    return value;
+                };
+                // Normalized integers map to [0, 1] or [-1, 1].
+                switch (component_type) {
+                    case component_byte:
+                        return normalized ? std::max(read(std::int8_t()) / 127.0, -1.0) : read(std::int8_t());
+                    case component_unsigned_byte:
+                        return normalized ? read(std::uint8_t()) / 255.0 : read(std::uint8_t());
+                    case component_short:
+                        return normalized ? std::max(read(std::int16_t()) / 32767.0, -1.0) : read(std::int16_t());
+                    case component_unsigned_short:
+                        return normalized ? read(std::uint16_t()) / 65535.0 : read(std::uint16_t());
+                    case component_unsigned_int:
+                        return read(std::uint32_t());
+                    default:
+                        return read(float());
+                }
+            }
+
+            [[nodiscard]] bool aligned(std::size_t alignment) const {
+                return reinterpret_cast<std::uintptr_t>(data) % alignment == 0;
+            }
+        };
+
+        std::string decodeUri(const std::string &uri) {
+            std::string result;
+            for (std::size_t index = 0; index < uri.size(); ++index) {
+                if (uri[index] == '%' && index + 2 < uri.size()) {
+                    result.push_back(static_cast<char>(std::stoi(uri.substr(index + 1, 2), nullptr, 16)));
+                    index += 2;
+                } else {
+                    result.push_back(uri[index]);
+                }
+            }
+            return result;
+        }
+
+        std::vector<char> decodeBase64(std::string_view text) {
+            auto value = [](char c) -> int {
+                if (c >= 'A' && c <= 'Z') {
+                    return c - 'A';
+                }
+                if (c >= 'a' && c <= 'z') {
+                    return c - 'a' + 26;
+                }
+                if (c >= '0' && c <= '9') {
+                    return c - '0' + 52;
+                }
+                return c == '+' ? 62 : c == '/' ? 63 : -1;
+            };
+            std::vector<char> result;
+            result.reserve(text.size() / 4 * 3);
+            std::uint32_t bits = 0;
+            int bitCount = 0;
+            for (auto c : text) {
+                auto digit = value(c);
+                if (digit < 0) {
+                    break;
+                }
+                bits = bits << 6 | static_cast<std::uint32_t>(digit);
+                bitCount += 6;
+                if (bitCount >= 8) {
+                    bitCount -= 8;
+                    result.push_back(static_cast<char>(bits >> bitCount & 0xFF));
+                }
+            }
+            return result;
+        }
+
+        class Document {
+        public:
+            Document(const std::filesystem::path &path, bool populate, Scene &scene) {
+                auto file = std::make_shared<const MappedFile>(path, populate);
+                scene.storage.push_back(file);
+                auto data = static_cast<const char *>(file->data());
+                std::string_view binary;
+                if (file->size() >= 12 && read<std::uint32_t>(data) == glb_magic) {
+                    if (read<std::uint32_t>(data + 4) != 2) {
+                        fail("GLB version");
+                    }
+                    // Chunks: the JSON chunk first, then an optional binary chunk, which is buffer 0.
+                    std::size_t offset = 12;
+                    std::string_view content;
+                    while (offset + 8 <= file->size()) {
+                        auto length = read<std::uint32_t>(data + offset);
+                        auto type = read<std::uint32_t>(data + offset + 4);
+                        if (length > file->size() - offset - 8) {
+                            fail("GLB chunk length");
+                        }
+                        std::string_view chunk(data + offset + 8, length);
+                        if (type == glb_chunk_json && content.empty()) {
+                            content = chunk;
+                        } else if (type == glb_chunk_bin && binary.data() == nullptr) {
+                            binary = chunk;
+                        }
+                        offset += 8 + (length + 3) / 4 * 4;
+                    }
+                    m_json = json::parse(content.begin(), content.end());
+                } else {
+                    m_json = json::parse(data, data + file->size());
+                }
+
+                for (const auto &buffer : member(m_json, "buffers")) {
+                    auto byteLength = buffer.at("byteLength").get<std::size_t>();
+                    if (!buffer.contains("uri")) {
+                        if (binary.size() < byteLength) {
+                            fail("missing binary chunk");
+                        }
+                        m_buffers.push_back(binary);
+                        continue;
+                    }
+                    auto uri = buffer["uri"].get<std::string>();
+                    if (uri.starts_with("data:")) {
+                        auto comma = uri.find(',');
+                        if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos) {
+                            fail("data URI");
+                        }
+                        auto owner = std::make_shared<const std::vector<char>>(decodeBase64(std::string_view(uri).substr(comma + 1)));
+                        scene.storage.push_back(owner);
+                        m_buffers.emplace_back(owner->data(), owner->size());
+                    } else {
+                        auto bufferFile = std::make_shared<const MappedFile>(path.parent_path() / decodeUri(uri), populate);
+                        scene.storage.push_back(bufferFile);
+                        m_buffers.emplace_back(static_cast<const char *>(bufferFile->data()), bufferFile->size());
+                    }
+                    if (m_buffers.back().size() < byteLength) {
+                        fail("buffer shorter than its byteLength");
+                    }
+                }
+            }
+
+            [[nodiscard]] const json &root() const {
+                return m_json;
+            }
+
+            [[nodiscard]] Accessor accessor(std::size_t index) const {
+                const auto &accessor = m_json.at("accessors").at(index);
+                if (accessor.contains("sparse") || !accessor.contains("bufferView")) {
+                    fail("sparse accessors are not supported");
+                }
+                const auto &view = m_json.at("bufferViews").at(accessor["bufferView"].get<std::size_t>());
+                const auto &buffer = m_buffers.at(view.at("buffer").get<std::size_t>());
+                Accessor result{};
+                result.count = accessor.at("count").get<std::size_t>();
+                result.component_type = accessor.at("componentType").get<int>();
+                result.components = componentCount(accessor.at("type").get<std::string>());
+                result.normalized = accessor.value("normalized", false);
+                auto elementSize = result.components * componentSize(result.component_type);
+                result.stride = view.value("byteStride", elementSize);
+                auto viewOffset = view.value("byteOffset", std::size_t(0));
+                auto viewLength = view.at("byteLength").get<std::size_t>();
+                auto offset = accessor.value("byteOffset", std::size_t(0));
+                if (viewOffset > buffer.size() || viewLength > buffer.size() - viewOffset) {
+                    fail("buffer view out of range");
+                }
+                if (result.count > 0 && (offset > viewLength || (result.count - 1) * result.stride + elementSize > viewLength - offset)) {
+                    fail("accessor out of range");
+                }
+                result.data = buffer.data() + viewOffset + offset;
+                return result;
+            }
+
+        private:
+            json m_json;
+            std::vector<std::string_view> m_buffers;
+
+            template<typename T>
+            static T read(const char *data) {
+                T value;
+                std::memcpy(&value, data, sizeof(T));
+                return value;
+            }
+        };
+
+        /**
+         * A triangle primitive with the world transform of the node instance referencing it.
+         */
+        struct Draw {
+            const json *primitive;
+            Matrix world;
+        };
+
+        void collect(const json &nodes, std::size_t index, const Matrix &parent, std::size_t depth, const json &meshes, std::vector<Draw> &draws) {
+            // A valid node hierarchy is a forest, so a longer path is a cycle.
+            if (depth > nodes.size()) {
+                fail("node hierarchy has a cycle");
+            }
+            const auto &node = nodes.at(index);
+            auto world = multiply(parent, nodeMatrix(node));
+            if (node.contains("mesh")) {
+                for (const auto &primitive : meshes.at(node["mesh"].get<std::size_t>()).at("primitives")) {
+                    if (primitive.value("mode", mode_triangles) == mode_triangles) {
+                        draws.push_back({&primitive, world});
+                    }
+                }
+            }
+            for (const auto &child : member(node, "children")) {
+                collect(nodes, child.get<std::size_t>(), world, depth + 1, meshes, draws);
+            }
+        }
+
+        std::vector<Draw> draws(const json &root) {
+            const auto &nodes = member(root, "nodes");
+            const auto &meshes = member(root, "meshes");
+            std::vector<std::size_t> roots;
+            if (root.contains("scenes") && !root["scenes"].empty()) {
+                const auto &scene = root["scenes"].at(root.value("scene", std::size_t(0)));
+                for (const auto &node : member(scene, "nodes")) {
+                    roots.push_back(node.get<std::size_t>());
+                }
+            } else {
+                // Without scenes, every node that is nobody's child.
+                std::vector<bool> child(nodes.size(), false);
+                for (const auto &node : nodes) {
+                    for (const auto &index : member(node, "children")) {
+                        child.at(index.get<std::size_t>()) = true;
+                    }
+                }
+                for (std::size_t index = 0; index < nodes.size(); ++index) {
+                    if (!child[index]) {
+                        roots.push_back(index);
+                    }
+                }
+            }
+            std::vector<Draw> result;
+            for (auto index : roots) {
+                collect(nodes, index, identity, 0, meshes, result);
+            }
+            return result;
+        }
+
+        std::array<GLfloat, 3> transformPoint(const Matrix &m, const std::array<double, 3> &p) {
+            return {
+                static_cast<GLfloat>(m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12]),
+                static_cast<GLfloat>(m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13]),
+                static_cast<GLfloat>(m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14]),
+            };
+        }
+
+        /**
+         * Cofactor matrix of the upper 3x3 block, which is the inverse transpose up to the determinant; normals are
+         * normalized afterwards, only the sign of the determinant is kept.
+         */
+        Matrix normalMatrix(const Matrix &m) {
+            auto a = [&m](std::size_t row, std::size_t column) {
+                return m[column * 4 + row];
+            };
+            Matrix result{};
+            for (std::size_t row = 0; row < 3; ++row) {
+                for (std::size_t column = 0; column < 3; ++column) {
+                    auto r0 = (row + 1) % 3, r1 = (row + 2) % 3;
+                    auto c0 = (column + 1) % 3, c1 = (column + 2) % 3;
+                    result[column * 4 + row] = a(r0, c0) * a(r1, c1) - a(r0, c1) * a(r1, c0);
+                }
+            }
+            auto determinant = a(0, 0) * result[0] + a(0, 1) * result[4] + a(0, 2) * result[8];
+            if (determinant < 0) {
+                for (auto &value : result) {
+                    value = -value;
+                }
+            }
+            return result;
+        }
+
+        std::array<GLfloat, 3> normalize(const std::array<double, 3> &v) {
+            auto length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (length == 0.0) {
+                return {0, 0, 0};
+            }
+            return {static_cast<GLfloat>(v[0] / length), static_cast<GLfloat>(v[1] / length), static_cast<GLfloat>(v[2] / length)};
+        }
+
+        std::array<double, 3> vector3(const Accessor &accessor, std::size_t index) {
+            return {accessor.component(index, 0), accessor.component(index, 1), accessor.component(index, 2)};
+        }
+
+        /**
+         * Whether the three attributes are one interleaved array of Vertex.
+         */
+        bool isVertexArray(const Accessor &position, const std::optional<Accessor> &normal, const std::optional<Accessor> &uv) {
+            if (!normal || !uv) {
+                return false;
+            }
+            auto matches = [&position](const Accessor &accessor, std::size_t components, std::size_t offset) {
+                return accessor.component_type == component_float && accessor.components == components &&
+                       accessor.stride == sizeof(Vertex) && accessor.count == position.count &&
+                       accessor.data == position.data + offset;
+            };
+            return position.aligned(alignof(Vertex)) &&
+                   matches(position, 3, offsetof(Vertex, location)) &&
+                   matches(*normal, 3, offsetof(Vertex, normal)) &&
+                   matches(*uv, 2, offsetof(Vertex, uv));
+        }
+
+        bool isTriangleArray(const Accessor &indices) {
+            return indices.component_type == component_unsigned_int && indices.components == 1 &&
+                   indices.stride == sizeof(GLuint) && indices.count % 3 == 0 && indices.aligned(alignof(Triangle));
+        }
+    }
+
+    bool isGltf(const std::filesystem::path &path) {
+        auto extension = path.extension();
+        return extension == ".gltf" || extension == ".glb";
+    }
+
+    Scene loadGltf(const std::filesystem::path &path, bool populate) {
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error("File not found: " + path.string());
+        }
+        Scene scene;
+        Document document(path, populate, scene);
+        auto primitives = draws(document.root());
+
+        std::vector<Vertex> vertices;
+        std::vector<Triangle> triangles;
+        // With a single primitive, no index needs a base offset, so an index array in the engine layout is used in place.
+        bool triangleArray = false;
+        for (const auto &draw : primitives) {
+            const auto &attributes = draw.primitive->at("attributes");
+            if (!attributes.contains("POSITION")) {
+                continue;
+            }
+            auto attribute = [&](const char *name) -> std::optional<Accessor> {
+                if (!attributes.contains(name)) {
+                    return std::nullopt;
+                }
+                return document.accessor(attributes[name].get<std::size_t>());
+            };
+            auto position = *attribute("POSITION");
+            auto normal = attribute("NORMAL");
+            auto uv = attribute("TEXCOORD_0");
+            std::optional<Accessor> indices;
+            if (draw.primitive->contains("indices")) {
+                indices = document.accessor((*draw.primitive)["indices"].get<std::size_t>());
+            }
+            auto cornerCount = indices ? indices->count : position.count;
+            auto corner = [&](std::size_t index) {
+                auto vertex = indices ? static_cast<std::size_t>(indices->component(index, 0)) : index;
+                if (vertex >= position.count) {
+                    fail("index out of range");
+                }
+                return vertex;
+            };
+
+            triangleArray = primitives.size() == 1 && normal && indices && isTriangleArray(*indices);
+            if (triangleArray) {
+                // Used in place, so the kernels read these indices unchecked: one pass over the mapping instead of a copy.
+                auto data = reinterpret_cast<const GLuint *>(indices->data);
+                if (std::any_of(data, data + indices->count, [&](GLuint vertex) { return vertex >= position.count; })) {
+                    fail("index out of range");
+                }
+                scene.triangles = {reinterpret_cast<const Triangle *>(indices->data), indices->count / 3};
+            }
+            if (triangleArray && draw.world == identity && isVertexArray(position, normal, uv)) {
+                scene.vertices = {reinterpret_cast<const Vertex *>(position.data), position.count};
+                return scene;
+            }
+
+            if (normal) {
+                auto matrix = normalMatrix(draw.world);
+                auto base = vertices.size();
+                for (std::size_t index = 0; index < position.count; ++index) {
+                    Vertex vertex{};
+                    auto location = transformPoint(draw.world, vector3(position, index));
+                    auto n = vector3(*normal, index);
+                    auto direction = normalize({
+                        matrix[0] * n[0] + matrix[4] * n[1] + matrix[8] * n[2],
+                        matrix[1] * n[0] + matrix[5] * n[1] + matrix[9] * n[2],
+                        matrix[2] * n[0] + matrix[6] * n[1] + matrix[10] * n[2],
+                    });
+                    std::copy(location.begin(), location.end(), vertex.location);
+                    std::copy(direction.begin(), direction.end(), vertex.normal);
+                    if (uv) {
+                        vertex.uv[0] = static_cast<GLfloat>(uv->component(index, 0));
+                        vertex.uv[1] = static_cast<GLfloat>(uv->component(index, 1));
+                    }
+                    vertices.push_back(vertex);
+                }
+                for (std::size_t index = 0; !triangleArray && index + 2 < cornerCount; index += 3) {
+                    triangles.push_back({
+                        static_cast<GLuint>(base + corner(index)),
+                        static_cast<GLuint>(base + corner(index + 1)),
+                        static_cast<GLuint>(base + corner(index + 2)),
+                    });
+                }
+                continue;
+            }
+
+            // Flat shading: every triangle gets its own three vertices with the face normal.
+            for (std::size_t index = 0; index + 2 < cornerCount; index += 3) {
+                Vertex triangle[3] = {};
+                for (std::size_t k = 0; k < 3; ++k) {
+                    auto vertex = corner(index + k);
+                    auto location = transformPoint(draw.world, vector3(position, vertex));
+                    std::copy(location.begin(), location.end(), triangle[k].location);
+                    if (uv) {
+                        triangle[k].uv[0] = static_cast<GLfloat>(uv->component(vertex, 0));
+                        triangle[k].uv[1] = static_cast<GLfloat>(uv->component(vertex, 1));
+                    }
+                }
+                std::array<double, 3> u, v;
+                for (std::size_t axis = 0; axis < 3; ++axis) {
+                    u[axis] = triangle[1].location[axis] - triangle[0].location[axis];
+                    v[axis] = triangle[2].location[axis] - triangle[0].location[axis];
+                }
+                auto face = normalize({u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]});
+                auto base = static_cast<GLuint>(vertices.size());
+                for (auto &vertex : triangle) {
+                    std::copy(face.begin(), face.end(), vertex.normal);
+                    vertices.push_back(vertex);
+                }
+                triangles.push_back({base, base + 1, base + 2});
+            }
+        }
+        if (vertices.size() > std::numeric_limits<GLuint>::max()) {
+            fail("too many vertices");
+        }
+        scene.vertices = scene.own(std::move(vertices));
+        if (!triangleArray) {
+            scene.triangles = scene.own(std::move(triangles));
+        }
+        return scene;
+    }
+}
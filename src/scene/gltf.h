@@ -0,0 +1,26 @@
+#ifndef RAYTRACE_GLTF_H
+#define RAYTRACE_GLTF_H
+
+#include <filesystem>
+#include "scene.h"
+
+/**
+ * glTF 2.0 loader (.gltf with external or embedded buffers, and .glb).
+ *
+ * Buffers are mapped, not read. When the scene is a single triangle primitive under an identity transform, accessors
+ * in the layout of the engine (interleaved float position, normal and uv with a 32 byte stride; unsigned int indices)
+ * become the scene arrays without a copy. Otherwise the primitives of every node are gathered into one mesh: there are
+ * no instances on the GPU, so each node instance is transformed into world space.
+ */
+namespace dragiyski::raytrace::scene {
+    [[nodiscard]] bool isGltf(const std::filesystem::path &path);
+
+    /**
+     * Loads the default scene (`scene`, or the first one) of a glTF asset. Only triangle primitives are read, with their
+     * POSITION, NORMAL and TEXCOORD_0 attributes; primitives without normals are flat shaded, as the specification
+     * requires. Sparse accessors are not supported.
+     */
+    Scene loadGltf(const std::filesystem::path &path, bool populate = false);
+}
+
+#endif //RAYTRACE_GLTF_H
@@ -0,0 +1,783 @@
+#include "importer.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include "mapped_file.h"
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        /**
+         * One corner of a triangle: indices into the position, uv and normal arrays of a Mesh, `missing` for an absent
+         * uv or normal.
+         */
+        struct Corner {
+            std::int64_t position;
+            std::int64_t uv;
+            std::int64_t normal;
+        };
+
+        constexpr std::int64_t missing = -1;
+
+        /**
+         * Parsed file before deduplication. Every three corners are a triangle.
+         */
+        struct Mesh {
+            std::vector<std::array<GLfloat, 3>> positions;
+            std::vector<std::array<GLfloat, 3>> normals;
+            std::vector<std::array<GLfloat, 2>> uvs;
+            std::vector<Corner> corners;
+        };
+
+        std::size_t threadCount() {
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        /**
+         * Calls `body(begin, end)` for contiguous ranges covering [0, count), one range per thread, and rethrows the first
+         * exception of any of them.
+         */
+        template<typename Body>
+        void parallelFor(std::size_t count, const Body &body) {
+            auto threads = std::min(threadCount(), std::max<std::size_t>(count, 1));
+            std::vector<std::thread> workers;
+            std::vector<std::exception_ptr> errors(threads);
+            for (std::size_t thread = 0; thread < threads; ++thread) {
+                workers.emplace_back([&, thread]() {
+                    try {
+                        body(count * thread / threads, count * (thread + 1) / threads);
+                    } catch (...) {
+                        errors[thread] = std::current_exception();
+                    }
+                });
+            }
+            for (auto &worker : workers) {
+                worker.join();
+            }
+            for (const auto &error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        struct VertexHash {
+            std::size_t operator()(const Vertex &vertex) const {
+                std::uint32_t words[sizeof(Vertex) / sizeof(std::uint32_t)];
+                std::memcpy(words, &vertex, sizeof(words));
+                std::uint64_t hash = 0xCBF29CE484222325ull;
+                for (auto word : words) {
+                    hash = (hash ^ word) * 0x100000001B3ull;
+                    hash ^= hash >> 29;
+                }
+                return static_cast<std::size_t>(hash);
+            }
+        };
+
+        // Bitwise equality: "identical" attributes, so 0.0 and -0.0 stay different vertices.
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const {
+                return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+            }
+        };
+
+        std::array<GLfloat, 3> faceNormal(const std::array<GLfloat, 3> &a, const std::array<GLfloat, 3> &b, const std::array<GLfloat, 3> &c) {
+            GLfloat u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            GLfloat v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            std::array<GLfloat, 3> normal = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+            auto length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0.0f) {
+                for (auto &component : normal) {
+                    component /= length;
+                }
+            }
+            return normal;
+        }
+
+        Vertex cornerVertex(const Mesh &mesh, std::size_t index) {
+            const auto &corner = mesh.corners[index];
+            Vertex vertex{};
+            const auto &position = mesh.positions[corner.position];
+            std::copy(position.begin(), position.end(), vertex.location);
+            if (corner.normal != missing) {
+                const auto &normal = mesh.normals[corner.normal];
+                std::copy(normal.begin(), normal.end(), vertex.normal);
+            } else {
+                auto first = index - index % 3;
+                auto normal = faceNormal(
+                    mesh.positions[mesh.corners[first].position],
+                    mesh.positions[mesh.corners[first + 1].position],
+                    mesh.positions[mesh.corners[first + 2].position]);
+                std::copy(normal.begin(), normal.end(), vertex.normal);
+            }
+            if (corner.uv != missing) {
+                const auto &uv = mesh.uvs[corner.uv];
+                std::copy(uv.begin(), uv.end(), vertex.uv);
+            }
+            return vertex;
+        }
+
+        /**
+         * Merges corners with identical vertices. Threads insert corners into one open addressing hash table without locks:
+         * a slot holds the first corner (plus one, 0 is empty) of a vertex and is claimed or lowered by compare and swap.
+         * The rank of a first corner among all first corners is the index of its vertex.
+         */
+        Scene deduplicate(const Mesh &mesh) {
+            auto count = mesh.corners.size();
+            // At most half full, so probe sequences stay short.
+            std::vector<std::atomic<std::uint64_t>> slots(std::bit_ceil(std::max<std::size_t>(2 * count, 1)));
+            auto mask = slots.size() - 1;
+            std::vector<std::size_t> slotOf(count);
+            parallelFor(count, [&](std::size_t begin, std::size_t end) {
+                for (auto index = begin; index < end; ++index) {
+                    auto vertex = cornerVertex(mesh, index);
+                    auto slot = VertexHash()(vertex) & mask;
+                    while (true) {
+                        auto current = slots[slot].load(std::memory_order_acquire);
+                        if (current == 0) {
+                            if (slots[slot].compare_exchange_strong(current, index + 1, std::memory_order_acq_rel)) {
+                                break;
+                            }
+                            // Another thread claimed the slot; `current` is its corner.
+                        }
+                        auto occupant = cornerVertex(mesh, current - 1);
+                        if (VertexEqual()(occupant, vertex)) {
+                            while (index + 1 < current && !slots[slot].compare_exchange_weak(current, index + 1, std::memory_order_acq_rel)) {
+                            }
+                            break;
+                        }
+                        slot = (slot + 1) & mask;
+                    }
+                    slotOf[index] = slot;
+                }
+            });
+
+            std::vector<std::uint32_t> rank(count + 1, 0);
+            parallelFor(slots.size(), [&](std::size_t begin, std::size_t end) {
+                for (auto slot = begin; slot < end; ++slot) {
+                    auto corner = slots[slot].load(std::memory_order_relaxed);
+                    if (corner != 0) {
+                        rank[corner - 1] = 1;
+                    }
+                }
+            });
+            std::uint64_t vertexCount = 0;
+            for (auto &value : rank) {
+                auto marked = value;
+                value = static_cast<std::uint32_t>(vertexCount);
+                vertexCount += marked;
+            }
+            if (vertexCount > std::numeric_limits<GLuint>::max() || count / 3 > std::numeric_limits<GLuint>::max()) {
+                throw std::runtime_error("Mesh too large");
+            }
+
+            std::vector<Vertex> vertices(vertexCount);
+            parallelFor(slots.size(), [&](std::size_t begin, std::size_t end) {
+                for (auto slot = begin; slot < end; ++slot) {
+                    auto corner = slots[slot].load(std::memory_order_relaxed);
+                    if (corner != 0) {
+                        vertices[rank[corner - 1]] = cornerVertex(mesh, corner - 1);
+                    }
+                }
+            });
+            std::vector<Triangle> triangles(count / 3);
+            parallelFor(triangles.size(), [&](std::size_t begin, std::size_t end) {
+                for (auto triangle = begin; triangle < end; ++triangle) {
+                    for (std::size_t corner = 0; corner < 3; ++corner) {
+                        triangles[triangle][corner] = rank[slots[slotOf[3 * triangle + corner]].load(std::memory_order_relaxed) - 1];
+                    }
+                }
+            });
+
+            Scene scene;
+            scene.vertices = scene.own(std::move(vertices));
+            scene.triangles = scene.own(std::move(triangles));
+            return scene;
+        }
+
+        void appendPolygon(std::vector<Corner> &corners, const std::vector<Corner> &polygon) {
+            for (std::size_t index = 2; index < polygon.size(); ++index) {
+                corners.push_back(polygon[0]);
+                corners.push_back(polygon[index - 1]);
+                corners.push_back(polygon[index]);
+            }
+        }
+
+        /**
+         * The OBJ file is parsed in parts split at line starts. Negative (relative) indices cannot be resolved before the
+         * number of elements in the previous parts is known, so they are stored as an index local to the part plus
+         * `relative_bias`.
+         */
+        constexpr std::int64_t relative_bias = std::int64_t(1) << 62;
+
+        class ObjParser {
+        public:
+            ObjParser(const char *begin, const char *end, Mesh &mesh) : m_current(begin), m_end(end), m_mesh(mesh) {
+            }
+
+            void parse() {
+                while (m_current < m_end) {
+                    auto eol = static_cast<const char *>(std::memchr(m_current, '\n', m_end - m_current));
+                    m_line_end = eol != nullptr ? eol : m_end;
+                    parseLine();
+                    m_current = m_line_end + 1;
+                }
+            }
+
+        private:
+            const char *m_current;
+            const char *m_end;
+            const char *m_line_end = nullptr;
+            Mesh &m_mesh;
+            std::vector<Corner> m_polygon;
+
+            [[noreturn]] void fail() const {
+                throw std::runtime_error("Invalid OBJ line: " + std::string(m_current, std::min<std::size_t>(m_line_end - m_current, 80)));
+            }
+
+            static bool isSpace(char c) {
+                return c == ' ' || c == '\t' || c == '\r';
+            }
+
+            const char *skipSpace(const char *p) const {
+                while (p < m_line_end && isSpace(*p)) {
+                    ++p;
+                }
+                return p;
+            }
+
+            template<std::size_t N>
+            std::array<GLfloat, N> parseFloats(const char *p) const {
+                std::array<GLfloat, N> result{};
+                for (auto &value : result) {
+                    p = skipSpace(p);
+                    if (p < m_line_end && *p == '+') {
+                        ++p;
+                    }
+                    auto [next, error] = std::from_chars(p, m_line_end, value);
+                    if (error != std::errc()) {
+                        fail();
+                    }
+                    p = next;
+                }
+                return result;
+            }
+
+            std::int64_t resolve(std::int64_t index, std::size_t count) const {
+                if (index > 0) {
+                    return index - 1;
+                }
+                if (index < 0) {
+                    return static_cast<std::int64_t>(count) + index + relative_bias;
+                }
+                fail();
+            }
+
+            // v, v/vt, v//vn or v/vt/vn
+            const char *parseCorner(const char *p, Corner &corner) const {
+                std::int64_t index;
+                auto result = std::from_chars(p, m_line_end, index);
+                if (result.ec != std::errc()) {
+                    fail();
+                }
+                corner = {resolve(index, m_mesh.positions.size()), missing, missing};
+                p = result.ptr;
+                if (p < m_line_end && *p == '/') {
+                    ++p;
+                    if (p < m_line_end && *p != '/') {
+                        result = std::from_chars(p, m_line_end, index);
+                        if (result.ec != std::errc()) {
+                            fail();
+                        }
+                        corner.uv = resolve(index, m_mesh.uvs.size());
+                        p = result.ptr;
+                    }
+                    if (p < m_line_end && *p == '/') {
+                        result = std::from_chars(p + 1, m_line_end, index);
+                        if (result.ec != std::errc()) {
+                            fail();
+                        }
+                        corner.normal = resolve(index, m_mesh.normals.size());
+                        p = result.ptr;
+                    }
+                }
+                return p;
+            }
+
+            void parseLine() {
+                auto p = skipSpace(m_current);
+                if (m_line_end - p < 2 || (!isSpace(p[1]) && !(p[0] == 'v' && (p[1] == 'n' || p[1] == 't')))) {
+                    return;
+                }
+                if (p[0] == 'v' && isSpace(p[1])) {
+                    m_mesh.positions.push_back(parseFloats<3>(p + 2));
+                } else if (p[0] == 'v' && p[1] == 'n') {
+                    m_mesh.normals.push_back(parseFloats<3>(p + 2));
+                } else if (p[0] == 'v' && p[1] == 't') {
+                    m_mesh.uvs.push_back(parseFloats<2>(p + 2));
+                } else if (p[0] == 'f') {
+                    m_polygon.clear();
+                    p = skipSpace(p + 2);
+                    while (p < m_line_end) {
+                        Corner corner{};
+                        p = skipSpace(parseCorner(p, corner));
+                        m_polygon.push_back(corner);
+                    }
+                    appendPolygon(m_mesh.corners, m_polygon);
+                }
+            }
+        };
+
+        Mesh parseObj(const MappedFile &file) {
+            auto data = static_cast<const char *>(file.data());
+            auto size = file.size();
+            // Several parts per thread, split at line starts.
+            auto partCount = std::max<std::size_t>(1, std::min(4 * threadCount(), size / 65536));
+            std::vector<std::size_t> starts = {0};
+            for (std::size_t part = 1; part < partCount; ++part) {
+                auto start = std::max(size * part / partCount, starts.back());
+                auto eol = static_cast<const char *>(std::memchr(data + start, '\n', size - start));
+                starts.push_back(eol != nullptr ? eol - data + 1 : size);
+            }
+            starts.push_back(size);
+            std::vector<Mesh> parts(partCount);
+            parallelFor(partCount, [&](std::size_t begin, std::size_t end) {
+                for (auto part = begin; part < end; ++part) {
+                    ObjParser(data + starts[part], data + starts[part + 1], parts[part]).parse();
+                }
+            });
+
+            // Offsets of every part in the concatenated arrays.
+            struct Offsets {
+                std::size_t positions = 0;
+                std::size_t normals = 0;
+                std::size_t uvs = 0;
+                std::size_t corners = 0;
+            };
+            std::vector<Offsets> offsets(partCount + 1);
+            for (std::size_t part = 0; part < partCount; ++part) {
+                offsets[part + 1] = {
+                    offsets[part].positions + parts[part].positions.size(),
+                    offsets[part].normals + parts[part].normals.size(),
+                    offsets[part].uvs + parts[part].uvs.size(),
+                    offsets[part].corners + parts[part].corners.size(),
+                };
+            }
+            Mesh mesh;
+            mesh.positions.resize(offsets.back().positions);
+            mesh.normals.resize(offsets.back().normals);
+            mesh.uvs.resize(offsets.back().uvs);
+            mesh.corners.resize(offsets.back().corners);
+            auto global = [](std::int64_t index, std::size_t offset, std::size_t count) {
+                if (index == missing) {
+                    return index;
+                }
+                if (index >= relative_bias / 2) {
+                    index += static_cast<std::int64_t>(offset) - relative_bias;
+                }
+                if (index < 0 || index >= static_cast<std::int64_t>(count)) {
+                    throw std::runtime_error("OBJ index out of range: " + std::to_string(index + 1));
+                }
+                return index;
+            };
+            parallelFor(partCount, [&](std::size_t begin, std::size_t end) {
+                for (auto part = begin; part < end; ++part) {
+                    const auto &from = parts[part];
+                    const auto &offset = offsets[part];
+                    std::copy(from.positions.begin(), from.positions.end(), mesh.positions.begin() + offset.positions);
+                    std::copy(from.normals.begin(), from.normals.end(), mesh.normals.begin() + offset.normals);
+                    std::copy(from.uvs.begin(), from.uvs.end(), mesh.uvs.begin() + offset.uvs);
+                    for (std::size_t index = 0; index < from.corners.size(); ++index) {
+                        const auto &corner = from.corners[index];
+                        mesh.corners[offset.corners + index] = {
+                            global(corner.position, offset.positions, mesh.positions.size()),
+                            global(corner.uv, offset.uvs, mesh.uvs.size()),
+                            global(corner.normal, offset.normals, mesh.normals.size()),
+                        };
+                    }
+                    parts[part] = {};
+                }
+            });
+            return mesh;
+        }
+
+        enum class PlyType {
+            int8, uint8, int16, uint16, int32, uint32, float32, float64
+        };
+
+        std::size_t plySize(PlyType type) {
+            switch (type) {
+                case PlyType::int8:
+                case PlyType::uint8:
+                    return 1;
+                case PlyType::int16:
+                case PlyType::uint16:
+                    return 2;
+                case PlyType::int32:
+                case PlyType::uint32:
+                case PlyType::float32:
+                    return 4;
+                case PlyType::float64:
+                    return 8;
+            }
+            return 0;
+        }
+
+        PlyType plyType(const std::string &name) {
+            static const std::unordered_map<std::string, PlyType> types = {
+                {"char", PlyType::int8}, {"int8", PlyType::int8},
+                {"uchar", PlyType::uint8}, {"uint8", PlyType::uint8},
+                {"short", PlyType::int16}, {"int16", PlyType::int16},
+                {"ushort", PlyType::uint16}, {"uint16", PlyType::uint16},
+                {"int", PlyType::int32}, {"int32", PlyType::int32},
+                {"uint", PlyType::uint32}, {"uint32", PlyType::uint32},
+                {"float", PlyType::float32}, {"float32", PlyType::float32},
+                {"double", PlyType::float64}, {"float64", PlyType::float64},
+            };
+            auto type = types.find(name);
+            if (type == types.end()) {
+                throw std::runtime_error("Invalid PLY property type: " + name);
+            }
+            return type->second;
+        }
+
+        template<typename T>
+        T plyRead(const char *data, bool swap) {
+            std::array<char, sizeof(T)> bytes;
+            std::memcpy(bytes.data(), data, sizeof(T));
+            if (swap) {
+                std::reverse(bytes.begin(), bytes.end());
+            }
+            return std::bit_cast<T>(bytes);
+        }
+
+        double plyValue(const char *data, PlyType type, bool swap) {
+            switch (type) {
+                case PlyType::int8:
+                    return plyRead<std::int8_t>(data, swap);
+                case PlyType::uint8:
+                    return plyRead<std::uint8_t>(data, swap);
+                case PlyType::int16:
+                    return plyRead<std::int16_t>(data, swap);
+                case PlyType::uint16:
+                    return plyRead<std::uint16_t>(data, swap);
+                case PlyType::int32:
+                    return plyRead<std::int32_t>(data, swap);
+                case PlyType::uint32:
+                    return plyRead<std::uint32_t>(data, swap);
+                case PlyType::float32:
+                    return plyRead<float>(data, swap);
+                case PlyType::float64:
+                    return plyRead<double>(data, swap);
+            }
+            return 0.0;
+        }
+
+        struct PlyProperty {
+            std::string name;
+            PlyType type;
+            bool list = false;
+            PlyType count_type = PlyType::uint8;
+        };
+
+        struct PlyElement {
+            std::string name;
+            std::size_t count;
+            std::vector<PlyProperty> properties;
+
+            // Size of a record without lists, 0 when a property is a list.
+            [[nodiscard]] std::size_t stride() const {
+                std::size_t size = 0;
+                for (const auto &property : properties) {
+                    if (property.list) {
+                        return 0;
+                    }
+                    size += plySize(property.type);
+                }
+                return size;
+            }
+        };
+
+        class PlyReader {
+        public:
+            explicit PlyReader(const MappedFile &file) : m_data(static_cast<const char *>(file.data())), m_size(file.size()) {
+                parseHeader();
+            }
+
+            Mesh read() {
+                Mesh mesh;
+                bool hasFaces = false;
+                for (const auto &element : m_elements) {
+                    if (element.name == "vertex") {
+                        readVertices(element, mesh);
+                    } else if (element.name == "face") {
+                        readFaces(element, mesh);
+                        hasFaces = true;
+                    } else {
+                        skip(element);
+                    }
+                }
+                if (!hasFaces) {
+                    throw std::runtime_error("PLY file without faces");
+                }
+                for (const auto &corner : mesh.corners) {
+                    if (corner.position < 0 || corner.position >= static_cast<std::int64_t>(mesh.positions.size())) {
+                        throw std::runtime_error("PLY index out of range: " + std::to_string(corner.position));
+                    }
+                }
+                return mesh;
+            }
+
+        private:
+            const char *m_data;
+            std::size_t m_size;
+            std::size_t m_offset = 0;
+            bool m_swap = false;
+            std::vector<PlyElement> m_elements;
+
+            void require(std::size_t size) const {
+                if (size > m_size - m_offset) {
+                    throw std::runtime_error("Truncated PLY file");
+                }
+            }
+
+            std::string_view line() {
+                auto eol = static_cast<const char *>(std::memchr(m_data + m_offset, '\n', m_size - m_offset));
+                if (eol == nullptr) {
+                    throw std::runtime_error("Truncated PLY header");
+                }
+                std::string_view result(m_data + m_offset, eol - m_data - m_offset);
+                m_offset = eol - m_data + 1;
+                if (!result.empty() && result.back() == '\r') {
+                    result.remove_suffix(1);
+                }
+                return result;
+            }
+
+            static std::vector<std::string> words(std::string_view text) {
+                std::vector<std::string> result;
+                std::size_t start = 0;
+                while ((start = text.find_first_not_of(" \t", start)) != std::string_view::npos) {
+                    auto end = std::min(text.find_first_of(" \t", start), text.size());
+                    result.emplace_back(text.substr(start, end - start));
+                    start = end;
+                }
+                return result;
+            }
+
+            void parseHeader() {
+                if (line() != "ply") {
+                    throw std::runtime_error("Not a PLY file");
+                }
+                while (true) {
+                    auto tokens = words(line());
+                    if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info") {
+                        continue;
+                    }
+                    if (tokens[0] == "end_header") {
+                        break;
+                    }
+                    if (tokens[0] == "format" && tokens.size() >= 2) {
+                        if (tokens[1] == "binary_little_endian") {
+                            m_swap = std::endian::native != std::endian::little;
+                        } else if (tokens[1] == "binary_big_endian") {
+                            m_swap = std::endian::native != std::endian::big;
+                        } else {
+                            throw std::runtime_error("Unsupported PLY format: " + tokens[1]);
+                        }
+                    } else if (tokens[0] == "element" && tokens.size() == 3) {
+                        m_elements.push_back({tokens[1], std::stoull(tokens[2]), {}});
+                    } else if (tokens[0] == "property" && !m_elements.empty()) {
+                        if (tokens.size() == 5 && tokens[1] == "list") {
+                            m_elements.back().properties.push_back({tokens[4], plyType(tokens[3]), true, plyType(tokens[2])});
+                        } else if (tokens.size() == 3) {
+                            m_elements.back().properties.push_back({tokens[2], plyType(tokens[1])});
+                        } else {
+                            throw std::runtime_error("Invalid PLY property");
+                        }
+                    } else {
+                        throw std::runtime_error("Invalid PLY header line: " + tokens[0]);
+                    }
+                }
+            }
+
+            // Offset of the named property in a record, SIZE_MAX when there is none.
+            static std::size_t find(const PlyElement &element, std::initializer_list<const char *> names, PlyType &type) {
+                std::size_t offset = 0;
+                for (const auto &property : element.properties) {
+                    for (auto name : names) {
+                        if (property.name == name) {
+                            type = property.type;
+                            return offset;
+                        }
+                    }
+                    offset += plySize(property.type);
+                }
+                return std::numeric_limits<std::size_t>::max();
+            }
+
+            void readVertices(const PlyElement &element, Mesh &mesh) {
+                auto stride = element.stride();
+                if (stride == 0) {
+                    throw std::runtime_error("PLY vertices with list properties");
+                }
+                require(stride * element.count);
+                constexpr auto none = std::numeric_limits<std::size_t>::max();
+                struct Field {
+                    std::size_t offset;
+                    PlyType type;
+                };
+                auto field = [&](std::initializer_list<const char *> names) {
+                    Field result{};
+                    result.offset = find(element, names, result.type);
+                    return result;
+                };
+                Field position[3] = {field({"x"}), field({"y"}), field({"z"})};
+                Field normal[3] = {field({"nx"}), field({"ny"}), field({"nz"})};
+                Field uv[2] = {field({"u", "s", "texture_u", "texture_s"}), field({"v", "t", "texture_v", "texture_t"})};
+                if (position[0].offset == none || position[1].offset == none || position[2].offset == none) {
+                    throw std::runtime_error("PLY vertices without position");
+                }
+                bool hasNormal = normal[0].offset != none && normal[1].offset != none && normal[2].offset != none;
+                bool hasUv = uv[0].offset != none && uv[1].offset != none;
+                mesh.positions.resize(element.count);
+                mesh.normals.resize(hasNormal ? element.count : 0);
+                mesh.uvs.resize(hasUv ? element.count : 0);
+                auto records = m_data + m_offset;
+                parallelFor(element.count, [&](std::size_t begin, std::size_t end) {
+                    for (auto index = begin; index < end; ++index) {
+                        auto record = records + index * stride;
+                        for (std::size_t axis = 0; axis < 3; ++axis) {
+                            mesh.positions[index][axis] = static_cast<GLfloat>(plyValue(record + position[axis].offset, position[axis].type, m_swap));
+                            if (hasNormal) {
+                                mesh.normals[index][axis] = static_cast<GLfloat>(plyValue(record + normal[axis].offset, normal[axis].type, m_swap));
+                            }
+                        }
+                        for (std::size_t axis = 0; hasUv && axis < 2; ++axis) {
+                            mesh.uvs[index][axis] = static_cast<GLfloat>(plyValue(record + uv[axis].offset, uv[axis].type, m_swap));
+                        }
+                    }
+                });
+                m_offset += stride * element.count;
+            }
+
+            Corner corner(const Mesh &mesh, const char *data, PlyType type) const {
+                auto index = static_cast<std::int64_t>(plyValue(data, type, m_swap));
+                return {index, mesh.uvs.empty() ? missing : index, mesh.normals.empty() ? missing : index};
+            }
+
+            void readFaces(const PlyElement &element, Mesh &mesh) {
+                auto indices = std::find_if(element.properties.begin(), element.properties.end(), [](const PlyProperty &property) {
+                    return property.list && (property.name == "vertex_indices" || property.name == "vertex_index");
+                });
+                if (indices == element.properties.end()) {
+                    throw std::runtime_error("PLY faces without vertex indices");
+                }
+                auto countSize = plySize(indices->count_type);
+                auto indexSize = plySize(indices->type);
+
+                // Nearly every PLY mesh is a list of triangles and nothing else: then every record has the same size and
+                // the faces are read in parallel.
+                auto triangleStride = countSize + 3 * indexSize;
+                if (element.properties.size() == 1 && triangleStride * element.count <= m_size - m_offset) {
+                    auto records = m_data + m_offset;
+                    bool triangles = true;
+                    for (std::size_t face = 0; face < element.count && triangles; ++face) {
+                        triangles = plyValue(records + face * triangleStride, indices->count_type, m_swap) == 3.0;
+                    }
+                    if (triangles) {
+                        mesh.corners.resize(3 * element.count);
+                        parallelFor(element.count, [&](std::size_t begin, std::size_t end) {
+                            for (auto face = begin; face < end; ++face) {
+                                auto record = records + face * triangleStride + countSize;
+                                for (std::size_t index = 0; index < 3; ++index) {
+                                    mesh.corners[3 * face + index] = corner(mesh, record + index * indexSize, indices->type);
+                                }
+                            }
+                        });
+                        m_offset += triangleStride * element.count;
+                        return;
+                    }
+                }
+
+                std::vector<Corner> polygon;
+                for (std::size_t face = 0; face < element.count; ++face) {
+                    for (const auto &property : element.properties) {
+                        if (!property.list) {
+                            require(plySize(property.type));
+                            m_offset += plySize(property.type);
+                            continue;
+                        }
+                        require(countSize);
+                        auto count = static_cast<std::size_t>(plyValue(m_data + m_offset, property.count_type, m_swap));
+                        m_offset += plySize(property.count_type);
+                        require(count * plySize(property.type));
+                        if (&property == &*indices) {
+                            polygon.clear();
+                            for (std::size_t index = 0; index < count; ++index) {
+                                polygon.push_back(corner(mesh, m_data + m_offset + index * indexSize, indices->type));
+                            }
+                            appendPolygon(mesh.corners, polygon);
+                        }
+                        m_offset += count * plySize(property.type);
+                    }
+                }
+            }
+
+            void skip(const PlyElement &element) {
+                auto stride = element.stride();
+                if (stride != 0) {
+                    require(stride * element.count);
+                    m_offset += stride * element.count;
+                    return;
+                }
+                for (std::size_t record = 0; record < element.count; ++record) {
+                    for (const auto &property : element.properties) {
+                        if (property.list) {
+                            require(plySize(property.count_type));
+                            auto count = static_cast<std::size_t>(plyValue(m_data + m_offset, property.count_type, m_swap));
+                            m_offset += plySize(property.count_type);
+                            require(count * plySize(property.type));
+                            m_offset += count * plySize(property.type);
+                        } else {
+                            require(plySize(property.type));
+                            m_offset += plySize(property.type);
+                        }
+                    }
+                }
+            }
+        };
+
+        std::string extension(const std::filesystem::path &path) {
+            auto result = path.extension().string();
+            std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+            return result;
+        }
+    }
+
+    bool isImportable(const std::filesystem::path &path) {
+        auto type = extension(path);
+        return type == ".obj" || type == ".ply";
+    }
+
+    Scene importMesh(const std::filesystem::path &path, bool populate) {
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error("File not found: " + path.string());
+        }
+        MappedFile file(path, populate);
+        auto mesh = extension(path) == ".obj" ? parseObj(file) : PlyReader(file).read();
+        return deduplicate(mesh);
+    }
+}
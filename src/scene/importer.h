@@ -0,0 +1,26 @@
+#ifndef RAYTRACE_IMPORTER_H
+#define RAYTRACE_IMPORTER_H
+
+#include <filesystem>
+#include "scene.h"
+
+/**
+ * Mesh importers. The file is mapped and parsed by all hardware threads, then corners with identical position, normal
+ * and uv are merged into one vertex. Vertices are numbered in order of first use, so the result does not depend on the
+ * number of threads. Faces with more than three corners are triangulated as fans; corners without a normal get the
+ * normal of their triangle, corners without uv get (0, 0).
+ */
+namespace dragiyski::raytrace::scene {
+    /**
+     * Whether the path has the extension of a format with an importer (.obj or .ply).
+     */
+    [[nodiscard]] bool isImportable(const std::filesystem::path &path);
+
+    /**
+     * Imports a Wavefront OBJ (.obj) or binary PLY (.ply) mesh. Only geometry is read: positions, normals, texture
+     * coordinates and faces; materials, groups, lines and points are skipped.
+     */
+    Scene importMesh(const std::filesystem::path &path, bool populate = false);
+}
+
+#endif //RAYTRACE_IMPORTER_H
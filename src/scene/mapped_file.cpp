@@ -0,0 +1,64 @@
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        std::runtime_error systemError(const char *operation, const std::filesystem::path &path) {
+            return std::runtime_error(std::string(operation) + " " + path.string() + ": " + std::strerror(errno));
+        }
+    }
+
+    MappedFile::MappedFile(const std::filesystem::path &path, bool populate) : m_data(nullptr), m_size(0) {
+        auto descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0) {
+            throw systemError("Cannot open", path);
+        }
+        struct stat status{};
+        if (fstat(descriptor, &status) < 0) {
+            auto error = systemError("Cannot stat", path);
+            close(descriptor);
+            throw error;
+        }
+        m_size = static_cast<std::size_t>(status.st_size);
+        if (m_size == 0) {
+            // Zero-length mappings are invalid; an empty file is an empty array.
+            close(descriptor);
+            return;
+        }
+        auto flags = MAP_PRIVATE | (populate ? MAP_POPULATE : 0);
+        auto data = mmap(nullptr, m_size, PROT_READ, flags, descriptor, 0);
+        // The mapping keeps its own reference to the file.
+        close(descriptor);
+        if (data == MAP_FAILED) {
+            throw systemError("Cannot map", path);
+        }
+        m_data = data;
+        // Buffers are read front to back (bounds, then the upload): start reading the whole file in the background and
+        // read ahead aggressively. The advice values are not flags, each needs its own call.
+        madvise(m_data, m_size, MADV_SEQUENTIAL);
+        if (!populate) {
+            madvise(m_data, m_size, MADV_WILLNEED);
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_data != nullptr) {
+            munmap(m_data, m_size);
+        }
+    }
+
+    const void *MappedFile::data() const {
+        return m_data;
+    }
+
+    std::size_t MappedFile::size() const {
+        return m_size;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef RAYTRACE_MAPPED_FILE_H
+#define RAYTRACE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+
+namespace dragiyski::raytrace::scene {
+    /**
+     * Read-only, private mapping of a whole file. The pages are read on first access (or all upfront with `populate`),
+     * so the contents can be handed to the GPU without an intermediate copy.
+     */
+    class MappedFile {
+    private:
+        void *m_data;
+        std::size_t m_size;
+    public:
+        explicit MappedFile(const std::filesystem::path &path, bool populate = false);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile();
+    public:
+        [[nodiscard]] const void *data() const;
+        [[nodiscard]] std::size_t size() const;
+    };
+}
+
+#endif //RAYTRACE_MAPPED_FILE_H
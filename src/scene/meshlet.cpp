@@ -0,0 +1,138 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        constexpr GLuint unused = std::numeric_limits<GLuint>::max();
+
+        void gather(const bvh::Tree &tree, GLuint index, std::vector<GLuint> &references) {
+            const auto &node = tree.nodes[index];
+            if (node.count > 0) {
+                references.insert(references.end(), tree.references.begin() + node.first, tree.references.begin() + node.first + node.count);
+                return;
+            }
+            gather(tree, node.first, references);
+            gather(tree, node.first + 1, references);
+        }
+    }
+
+    Meshlets buildMeshlets(Scene &scene, std::size_t max_triangles) {
+        if (max_triangles == 0 || max_triangles > meshlet_max_triangles) {
+            throw std::invalid_argument("Meshlets hold 1 to " + std::to_string(meshlet_max_triangles) + " triangles, not " + std::to_string(max_triangles));
+        }
+        if (scene.triangles.empty()) {
+            return {};
+        }
+        // Triangles come first in the numbering of the scene, so dropping the spheres leaves a tree over triangles.
+        auto bounds = scene.bounds();
+        auto references = scene.references();
+        bounds.resize(scene.triangles.size());
+        references.resize(scene.triangles.size());
+        auto tree = bvh::build(bounds, references);
+        auto sizes = bvh::subtreeSizes(tree);
+
+        std::vector<Meshlet> table;
+        std::vector<GLuint> data;
+        // Index of a scene vertex in the current meshlet.
+        std::vector<GLuint> localVertex(scene.vertexCount(), unused);
+        std::vector<GLuint> vertices;
+        std::vector<GLuint> triangles;
+        auto box = bvh::Bounds::empty();
+
+        auto flush = [&]() {
+            if (triangles.empty()) {
+                return;
+            }
+            Meshlet meshlet{};
+            std::copy(std::begin(box.min), std::end(box.min), meshlet.min);
+            std::copy(std::begin(box.max), std::end(box.max), meshlet.max);
+            meshlet.offset = static_cast<GLuint>(data.size());
+            meshlet.vertex_count = static_cast<GLushort>(vertices.size());
+            meshlet.triangle_count = static_cast<GLushort>(triangles.size());
+            data.insert(data.end(), vertices.begin(), vertices.end());
+            data.insert(data.end(), triangles.begin(), triangles.end());
+            table.push_back(meshlet);
+            for (auto vertex : vertices) {
+                localVertex[vertex] = unused;
+            }
+            vertices.clear();
+            triangles.clear();
+            box = bvh::Bounds::empty();
+        };
+
+        // Appends a triangle to the current meshlet, or to a new one when it does not fit.
+        auto add = [&](GLuint index) {
+            const auto &triangle = scene.triangles[index];
+            std::size_t added = 0;
+            for (std::size_t corner = 0; corner < 3; ++corner) {
+                auto vertex = triangle[corner];
+                added += localVertex[vertex] == unused && (corner == 0 || vertex != triangle[0]) && (corner < 2 || vertex != triangle[1]);
+            }
+            if (triangles.size() == max_triangles || vertices.size() + added > meshlet_max_vertices) {
+                flush();
+            }
+            GLuint corners = 0;
+            for (std::size_t corner = 0; corner < 3; ++corner) {
+                auto vertex = triangle[corner];
+                if (localVertex[vertex] == unused) {
+                    localVertex[vertex] = static_cast<GLuint>(vertices.size());
+                    vertices.push_back(vertex);
+                    box.extend(scene.location(vertex).data());
+                }
+                corners |= localVertex[vertex] << (8 * corner);
+            }
+            triangles.push_back(corners);
+        };
+
+        std::vector<GLuint> stack = {0};
+        std::vector<GLuint> subtree;
+        while (!stack.empty()) {
+            auto index = stack.back();
+            stack.pop_back();
+            const auto &node = tree.nodes[index];
+            if (sizes[index] > max_triangles && node.count == 0) {
+                stack.push_back(node.first + 1);
+                stack.push_back(node.first);
+                continue;
+            }
+            // Every candidate subtree starts a meshlet of its own, so nearby subtrees are never mixed.
+            flush();
+            subtree.clear();
+            gather(tree, index, subtree);
+            std::size_t vertexCount = 0;
+            for (auto triangle : subtree) {
+                for (auto vertex : scene.triangles[triangle]) {
+                    if (localVertex[vertex] == unused) {
+                        localVertex[vertex] = 0;
+                        ++vertexCount;
+                    }
+                }
+            }
+            for (auto triangle : subtree) {
+                for (auto vertex : scene.triangles[triangle]) {
+                    localVertex[vertex] = unused;
+                }
+            }
+            if (vertexCount > meshlet_max_vertices && node.count == 0) {
+                stack.push_back(node.first + 1);
+                stack.push_back(node.first);
+                continue;
+            }
+            for (auto triangle : subtree) {
+                add(triangle);
+            }
+        }
+        flush();
+
+        if (table.size() > meshlet_max_count) {
+            throw std::runtime_error("Too many meshlets: " + std::to_string(table.size()) + ", at most " + std::to_string(meshlet_max_count));
+        }
+        Meshlets result;
+        result.table = scene.own(std::move(table));
+        result.data = scene.own(std::move(data));
+        return result;
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef RAYTRACE_MESHLET_H
+#define RAYTRACE_MESHLET_H
+
+#include <cstddef>
+#include "scene.h"
+
+namespace dragiyski::raytrace::scene {
+    /**
+     * Corners are 8-bit indices into the vertices of their meshlet, and hits report the 8-bit index of the triangle.
+     */
+    constexpr std::size_t meshlet_max_vertices = 256;
+    constexpr std::size_t meshlet_max_triangles = 256;
+
+    /**
+     * A hit on a meshlet triangle is `meshlet << 8 | triangle`, which has to stay clear of bvh::reference_sphere.
+     */
+    constexpr std::size_t meshlet_max_count = (bvh::reference_index >> 8) + 1;
+
+    /**
+     * Splits the triangles of the scene into meshlets of at most `max_triangles` (at most meshlet_max_triangles) and
+     * meshlet_max_vertices: the largest subtrees of a SAH tree over the triangles that fit. A leaf that does not fit is
+     * split in order. Bounds are tight around the triangles, spheres are not part of any meshlet. The arrays are owned
+     * by `scene`.
+     */
+    Meshlets buildMeshlets(Scene &scene, std::size_t max_triangles);
+}
+
+#endif //RAYTRACE_MESHLET_H
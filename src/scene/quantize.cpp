@@ -0,0 +1,126 @@
+#include "quantize.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        constexpr GLfloat max_step = 65535.0f;
+
+        // Smallest power of two step that covers `extent` in max_step steps.
+        GLfloat gridStep(GLfloat extent) {
+            if (!(extent > 0.0f)) {
+                return 1.0f;
+            }
+            int exponent;
+            std::frexp(extent / max_step, &exponent);
+            auto step = std::ldexp(1.0f, exponent);
+            // frexp rounds the exponent down for exact powers of two, which already fit.
+            return step / 2.0f * max_step >= extent ? step / 2.0f : step;
+        }
+
+        std::uint16_t toSnorm16(GLfloat value) {
+            return static_cast<std::uint16_t>(static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f)));
+        }
+
+        // Round to nearest even; overflow saturates to infinity and values below the half range flush through
+        // subnormals like the hardware conversion.
+        std::uint16_t toHalf(GLfloat value) {
+            auto bits = std::bit_cast<std::uint32_t>(value);
+            std::uint32_t sign = (bits >> 16) & 0x8000u;
+            std::uint32_t magnitude = bits & 0x7FFFFFFFu;
+            if (magnitude >= 0x7F800000u) {
+                return static_cast<std::uint16_t>(sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u));
+            }
+            if (magnitude >= 0x477FF000u) {
+                return static_cast<std::uint16_t>(sign | 0x7C00u);
+            }
+            if (magnitude < 0x38800000u) {
+                // Subnormal half: the float, scaled to units of 2^-24, rounds to an integer.
+                auto scaled = std::nearbyint(std::bit_cast<GLfloat>(magnitude) * 16777216.0f);
+                return static_cast<std::uint16_t>(sign | static_cast<std::uint32_t>(scaled));
+            }
+            std::uint32_t half = ((magnitude - 0x38000000u) >> 13);
+            std::uint32_t rest = magnitude & 0x1FFFu;
+            if (rest > 0x1000u || (rest == 0x1000u && (half & 1u) != 0)) {
+                ++half;
+            }
+            return static_cast<std::uint16_t>(sign | half);
+        }
+
+        // Octahedral normal encoding (Cigolle et al., "A Survey of Efficient Representations for Independent Unit
+        // Vectors", 2014).
+        GLuint encodeNormal(const GLfloat *normal) {
+            auto length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+            if (!(length > 0.0f)) {
+                return 0;
+            }
+            GLfloat x = normal[0] / length, y = normal[1] / length;
+            if (normal[2] < 0.0f) {
+                auto foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                auto foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+                x = foldedX;
+                y = foldedY;
+            }
+            return GLuint(toSnorm16(x)) | GLuint(toSnorm16(y)) << 16;
+        }
+    }
+
+    QuantizedVertices quantize(const Scene &scene) {
+        QuantizedVertices result;
+        auto count = scene.vertexCount();
+        auto blocks = (count + quantized_block_size - 1) / quantized_block_size;
+        result.positions.resize(count + quantized_block_header * blocks);
+        result.attributes.resize(count);
+        for (std::size_t block = 0; block < blocks; ++block) {
+            auto first = block * quantized_block_size;
+            auto size = std::min(quantized_block_size, count - first);
+            GLfloat min[3], step[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                GLfloat low = scene.location(first)[axis], high = low;
+                for (std::size_t index = 1; index < size; ++index) {
+                    low = std::min(low, scene.location(first + index)[axis]);
+                    high = std::max(high, scene.location(first + index)[axis]);
+                }
+                min[axis] = low;
+                step[axis] = gridStep(high - min[axis]);
+            }
+            auto *header = &result.positions[block * (quantized_block_size + quantized_block_header)];
+            for (int axis = 0; axis < 3; ++axis) {
+                header[axis / 2][axis % 2] = std::bit_cast<GLuint>(min[axis]);
+                header[(axis + 3) / 2][(axis + 3) % 2] = std::bit_cast<GLuint>(step[axis]);
+            }
+
+            for (std::size_t index = 0; index < size; ++index) {
+                auto vertex = scene.vertex(first + index);
+                auto &position = header[quantized_block_header + index];
+                auto &attributes = result.attributes[first + index];
+                std::uint32_t steps[3];
+                for (int axis = 0; axis < 3; ++axis) {
+                    auto rounded = std::nearbyint((vertex.location[axis] - min[axis]) / step[axis]);
+                    steps[axis] = static_cast<std::uint32_t>(std::clamp(rounded, 0.0f, max_step));
+                }
+                position[0] = steps[0] | steps[1] << 16;
+                position[1] = steps[2];
+                attributes[0] = encodeNormal(vertex.normal);
+                attributes[1] = GLuint(toHalf(vertex.uv[0])) | GLuint(toHalf(vertex.uv[1])) << 16;
+            }
+        }
+        return result;
+    }
+
+    Position decodePosition(std::span<const QuantizedRecord> positions, std::size_t vertex) {
+        const auto *header = &positions[vertex / quantized_block_size * (quantized_block_size + quantized_block_header)];
+        const auto &record = header[quantized_block_header + vertex % quantized_block_size];
+        GLuint steps[3] = {record[0] & 0xFFFFu, record[0] >> 16, record[1] & 0xFFFFu};
+        Position result;
+        for (int axis = 0; axis < 3; ++axis) {
+            auto min = std::bit_cast<GLfloat>(header[axis / 2][axis % 2]);
+            auto step = std::bit_cast<GLfloat>(header[(axis + 3) / 2][(axis + 3) % 2]);
+            // Exact product (a 16-bit integer times a power of two), so only the sum rounds, as on the GPU.
+            result[axis] = min + static_cast<GLfloat>(steps[axis]) * step;
+        }
+        return result;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef RAYTRACE_QUANTIZE_H
+#define RAYTRACE_QUANTIZE_H
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <GL/gl.h>
+#include "scene.h"
+
+/**
+ * Compressed vertex streams, in the VERTEX_QUANTIZED layout of var/raytrace/scene.glsl: 16 bytes per vertex instead of
+ * 32, in two 8-byte records.
+ *
+ * Position records hold three 16-bit multiples of a grid step above a minimum (the top half of the second word is
+ * unused). Vertices are grouped in blocks of `quantized_block_size` consecutive vertices, each with its own grid: the
+ * block is preceded by three records with the minimum and then the step, six floats. The step is a power of two, so a
+ * position decodes to the same float on the CPU and on the GPU.
+ *
+ * Blocks follow the vertex numbering, not space: vertices are not reordered. That suits the OBJ and PLY importers,
+ * which number vertices in order of first use, but raw and glTF vertex arrays keep the order of the file, where a
+ * block may span the whole mesh and its grid be as coarse as the mesh bounds over 65535 steps.
+ *
+ * Attribute records hold the normal in octahedral encoding as two snorm16, then the uv as two half floats.
+ */
+namespace dragiyski::raytrace::scene {
+    constexpr std::size_t quantized_block_size = 256;
+
+    constexpr std::size_t quantized_block_header = 3;
+
+    struct QuantizedVertices {
+        std::vector<QuantizedRecord> positions;
+        std::vector<QuantizedRecord> attributes;
+    };
+
+    QuantizedVertices quantize(const Scene &scene);
+
+    /**
+     * The position of `vertex` as the kernels decode it from the quantized position stream.
+     */
+    Position decodePosition(std::span<const QuantizedRecord> positions, std::size_t vertex);
+}
+
+#endif //RAYTRACE_QUANTIZE_H
@@ -0,0 +1,136 @@
+#include "scene.h"
+#include <algorithm>
+#include <stdexcept>
+#include "container.h"
+#include "gltf.h"
+#include "importer.h"
+#include "mapped_file.h"
+#include "quantize.h"
+
+namespace dragiyski::raytrace::scene {
+    namespace {
+        template<typename T>
+        std::span<const T> mapArray(const std::filesystem::path &filepath, bool populate, Scene &scene) {
+            if (!std::filesystem::exists(filepath)) {
+                throw std::runtime_error("File not found: " + filepath.string());
+            }
+            auto file = std::make_shared<const MappedFile>(filepath, populate);
+            if (file->size() % sizeof(T) != 0) {
+                throw std::runtime_error("Invalid buffer size: " + filepath.string());
+            }
+            scene.storage.push_back(file);
+            // Mappings are page aligned, which satisfies the alignment of every element type.
+            return {static_cast<const T *>(file->data()), file->size() / sizeof(T)};
+        }
+    }
+
+    std::size_t Scene::primitiveCount() const {
+        return triangles.size() + spheres.size();
+    }
+
+    std::vector<bvh::Bounds> Scene::bounds() const {
+        std::vector<bvh::Bounds> result;
+        result.reserve(primitiveCount());
+        for (const auto &triangle : triangles) {
+            auto triangleBounds = bvh::Bounds::empty();
+            for (auto vertex : triangle) {
+                triangleBounds.extend(location(vertex).data());
+            }
+            result.push_back(triangleBounds);
+        }
+        for (const auto &sphere : spheres) {
+            result.push_back({
+                {sphere.center[0] - sphere.radius, sphere.center[1] - sphere.radius, sphere.center[2] - sphere.radius},
+                {sphere.center[0] + sphere.radius, sphere.center[1] + sphere.radius, sphere.center[2] + sphere.radius},
+            });
+        }
+        return result;
+    }
+
+    std::vector<GLuint> Scene::references() const {
+        std::vector<GLuint> result;
+        result.reserve(primitiveCount());
+        for (std::size_t index = 0; index < triangles.size(); ++index) {
+            result.push_back(static_cast<GLuint>(index));
+        }
+        for (std::size_t index = 0; index < spheres.size(); ++index) {
+            result.push_back(static_cast<GLuint>(index) | bvh::reference_sphere);
+        }
+        return result;
+    }
+
+    bvh::Bounds Scene::clip(std::size_t index, const bvh::Bounds &box) const {
+        if (index < triangles.size()) {
+            const auto &triangle = triangles[index];
+            auto a = location(triangle[0]), b = location(triangle[1]), c = location(triangle[2]);
+            return bvh::clipTriangle(a.data(), b.data(), c.data(), box);
+        }
+        // The box of a sphere is a conservative, but not tight, bound of its part inside another box.
+        const auto &sphere = spheres[index - triangles.size()];
+        bvh::Bounds bounds = {
+            {sphere.center[0] - sphere.radius, sphere.center[1] - sphere.radius, sphere.center[2] - sphere.radius},
+            {sphere.center[0] + sphere.radius, sphere.center[1] + sphere.radius, sphere.center[2] + sphere.radius},
+        };
+        return bounds.intersect(box);
+    }
+
+    std::size_t Scene::vertexCount() const {
+        return vertices.empty() ? positions.size() : vertices.size();
+    }
+
+    Position Scene::location(std::size_t vertex) const {
+        if (!quantized_positions.empty()) {
+            return decodePosition(quantized_positions, vertex);
+        }
+        if (vertices.empty()) {
+            return positions[vertex];
+        }
+        return {vertices[vertex].location[0], vertices[vertex].location[1], vertices[vertex].location[2]};
+    }
+
+    Vertex Scene::vertex(std::size_t index) const {
+        Vertex result = vertices.empty() ? Vertex{} : vertices[index];
+        auto position = location(index);
+        std::copy(position.begin(), position.end(), result.location);
+        if (vertices.empty()) {
+            std::copy(std::begin(attributes[index].normal), std::end(attributes[index].normal), result.normal);
+            std::copy(std::begin(attributes[index].uv), std::end(attributes[index].uv), result.uv);
+        }
+        return result;
+    }
+
+    bool validTriangles(std::span<const Triangle> triangles, std::size_t vertex_count) {
+        return std::all_of(triangles.begin(), triangles.end(), [&](const Triangle &triangle) {
+            return triangle[0] < vertex_count && triangle[1] < vertex_count && triangle[2] < vertex_count;
+        });
+    }
+
+    Scene load(const std::filesystem::path &model, const std::filesystem::path &spheres, bool populate) {
+        Scene scene;
+        auto prefix = model.string();
+        scene.vertices = mapArray<Vertex>(prefix + ".vbo.bin", populate, scene);
+        scene.triangles = mapArray<Triangle>(prefix + ".ibo.bin", populate, scene);
+        if (!validTriangles(scene.triangles, scene.vertexCount())) {
+            throw std::runtime_error("Vertex index out of range: " + prefix + ".ibo.bin");
+        }
+        // Spheres are optional: the file is a raw array of Sphere, like the mesh buffers.
+        if (std::filesystem::exists(spheres)) {
+            scene.spheres = mapArray<Sphere>(spheres, populate, scene);
+        }
+        return scene;
+    }
+
+    Scene open(const std::filesystem::path &path, const std::filesystem::path &spheres, bool populate) {
+        if (container::isContainer(path)) {
+            return container::read(path, populate);
+        }
+        if (!isImportable(path) && !isGltf(path)) {
+            return load(path, spheres, populate);
+        }
+        auto scene = isGltf(path) ? loadGltf(path, populate) : importMesh(path, populate);
+        if (std::filesystem::exists(spheres)) {
+            scene.spheres = mapArray<Sphere>(spheres, populate, scene);
+        }
+        return scene;
+    }
+}
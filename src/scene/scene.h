@@ -0,0 +1,191 @@
+#ifndef RAYTRACE_SCENE_H
+#define RAYTRACE_SCENE_H
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+#include <GL/gl.h>
+#include "bvh/bvh.h"
+
+typedef struct {
+    GLfloat location[3];
+    GLfloat normal[3];
+    GLfloat uv[2];
+} Vertex;
+
+typedef struct {
+    GLfloat center[3];
+    GLfloat radius;
+    GLfloat color[4];
+} Sphere;
+
+namespace dragiyski::raytrace::scene {
+    typedef std::array<GLuint, 3> Triangle;
+    typedef std::array<GLfloat, 3> Position;
+    // Eight bytes of a quantized vertex stream (see quantize.h).
+    typedef std::array<GLuint, 2> QuantizedRecord;
+
+    /**
+     * Shading attributes of a vertex: everything but the location, which is all that intersection needs.
+     */
+    struct Attributes {
+        GLfloat normal[3];
+        GLfloat uv[2];
+    };
+
+    /**
+     * Part of the geometry that is paged to the GPU as a unit (see cluster.h): a subtree of the scene BVH with its own
+     * copy of the vertices and triangles it references. Offsets and counts are into the arrays of Clusters.
+     */
+    struct Cluster {
+        GLfloat min[3];
+        GLuint vertex_offset;
+        GLfloat max[3];
+        GLuint vertex_count;
+        GLuint triangle_offset;
+        GLuint triangle_count;
+        GLuint node_offset;
+        GLuint node_count;
+        GLuint reference_offset;
+        GLuint reference_count;
+    };
+
+    /**
+     * Clustered copy of the geometry, empty unless built or stored with the scene.
+     * Triangles index the vertices of their cluster, nodes form one tree per cluster (indices local to it) and
+     * references are triangles of the cluster or, with bvh::reference_sphere, spheres of the scene.
+     */
+    struct Clusters {
+        std::span<const Cluster> table;
+        std::span<const Vertex> vertices;
+        std::span<const Triangle> triangles;
+        std::span<const bvh::Node> nodes;
+        std::span<const GLuint> references;
+    };
+
+    /**
+     * Up to 256 triangles and 256 vertices that are close in space (see meshlet.h), matching `Meshlet` in
+     * var/raytrace/scene.glsl (std430, 32 bytes). The words of Meshlets::data from `offset` are the `vertex_count` scene
+     * vertex indices of the meshlet, then its triangles, one word each with the three 8-bit local indices of its
+     * corners in the low three bytes.
+     */
+    struct Meshlet {
+        GLfloat min[3];
+        GLuint offset;
+        GLfloat max[3];
+        GLushort vertex_count;
+        GLushort triangle_count;
+    };
+
+    /**
+     * Meshlets covering every triangle once, empty unless built or stored with the scene.
+     */
+    struct Meshlets {
+        std::span<const Meshlet> table;
+        std::span<const GLuint> data;
+    };
+
+    /**
+     * Most vertices `splitVertices` copies at once.
+     */
+    constexpr std::size_t vertex_batch_size = 65536;
+
+    /**
+     * Splits interleaved vertices into the position and attribute streams one batch at a time, so that the copy never
+     * takes more than a batch of memory. `consume(first, positions, attributes)` receives the batches in order.
+     */
+    template<typename Consume>
+    void splitVertices(std::span<const Vertex> vertices, Consume &&consume) {
+        std::vector<Position> positions;
+        std::vector<Attributes> attributes;
+        for (std::size_t first = 0; first < vertices.size(); first += vertex_batch_size) {
+            auto batch = vertices.subspan(first, std::min(vertex_batch_size, vertices.size() - first));
+            positions.resize(batch.size());
+            attributes.resize(batch.size());
+            for (std::size_t index = 0; index < batch.size(); ++index) {
+                std::copy(std::begin(batch[index].location), std::end(batch[index].location), positions[index].begin());
+                std::copy(std::begin(batch[index].normal), std::end(batch[index].normal), attributes[index].normal);
+                std::copy(std::begin(batch[index].uv), std::end(batch[index].uv), attributes[index].uv);
+            }
+            consume(first, std::span<const Position>(positions), std::span<const Attributes>(attributes));
+        }
+    }
+
+    /**
+     * Geometry of the renderer: an indexed triangle mesh and analytic spheres.
+     * Primitives are numbered triangles first, then spheres; `bounds`, `references` and `clip` use that numbering.
+     * The arrays are views: `storage` owns the memory behind them, file mappings or arrays built by the loader.
+     */
+    struct Scene {
+        /**
+         * The vertices, interleaved as the raw, glTF and imported meshes have them, or as two streams (positions for
+         * intersection, attributes for shading) as containers store them. One of the two is empty.
+         */
+        std::span<const Vertex> vertices;
+        std::span<const Position> positions;
+        std::span<const Attributes> attributes;
+        std::span<const Triangle> triangles;
+        std::span<const Sphere> spheres;
+        std::vector<std::shared_ptr<const void>> storage;
+
+        /**
+         * Tree stored with the scene (see container.h), empty when there is none. `bvh_spatial` is set when it was built
+         * with spatial splits.
+         */
+        bvh::Tree bvh;
+        bool bvh_spatial = false;
+
+        Clusters clusters;
+        Meshlets meshlets;
+
+        /**
+         * With --quantize, the quantized position stream (see quantize.h). `location` then decodes the positions the
+         * kernels intersect from it, so that what is built on the CPU bounds them, without keeping a decoded copy.
+         */
+        std::span<const QuantizedRecord> quantized_positions;
+
+        /**
+         * Takes ownership of `data` and returns a view of it.
+         */
+        template<typename T>
+        std::span<const T> own(std::vector<T> &&data) {
+            auto owner = std::make_shared<const std::vector<T>>(std::move(data));
+            storage.push_back(owner);
+            return {owner->data(), owner->size()};
+        }
+
+        [[nodiscard]] std::size_t primitiveCount() const;
+        [[nodiscard]] std::vector<bvh::Bounds> bounds() const;
+        [[nodiscard]] std::vector<GLuint> references() const;
+        [[nodiscard]] bvh::Bounds clip(std::size_t index, const bvh::Bounds &box) const;
+
+        [[nodiscard]] std::size_t vertexCount() const;
+        [[nodiscard]] Position location(std::size_t vertex) const;
+        [[nodiscard]] Vertex vertex(std::size_t index) const;
+    };
+
+    /**
+     * Whether every corner of `triangles` is one of `vertex_count` vertices. Loaders check indices they hand out
+     * unchanged, which everything from the bounds to the kernels then reads without checks.
+     */
+    [[nodiscard]] bool validTriangles(std::span<const Triangle> triangles, std::size_t vertex_count);
+
+    /**
+     * Maps the raw vertex and index arrays `<model>.vbo.bin` and `<model>.ibo.bin`, and the raw sphere array when the
+     * `spheres` file exists. Nothing is copied: the arrays point into the mappings, whose pages are read on first access
+     * or, with `populate`, before returning. The indices are checked once, which reads the whole index file.
+     */
+    Scene load(const std::filesystem::path &model, const std::filesystem::path &spheres, bool populate = false);
+
+    /**
+     * Loads a scene container (a path ending with `.rtscene`), a glTF asset (see gltf.h), imports an OBJ or PLY mesh
+     * (see importer.h) or, for any other path, maps the raw arrays of `load`. Everything but containers takes its spheres
+     * from the `spheres` file, like `load`.
+     */
+    Scene open(const std::filesystem::path &path, const std::filesystem::path &spheres, bool populate = false);
+}
+
+#endif //RAYTRACE_SCENE_H
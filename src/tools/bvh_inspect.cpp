@@ -0,0 +1,261 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "global.h"
+#include "bvh/bvh.h"
+#include "grid/grid.h"
+#include "scene/cluster.h"
+#include "scene/meshlet.h"
+#include "scene/scene.h"
+
+// Builds every acceleration structure over a model and prints their quality statistics as JSON, so that trees can be
+// compared across versions with a plain diff.
+//
+// Usage: raytrace-bvh-inspect [--model <prefix>] [--spheres <file>] [--sbvh-alpha <alpha>] [--grid-density <density>]
+//                              [--meshlet-size <triangles>] [--cluster-size <primitives>]
+// The model is a scene container (.rtscene), a glTF asset, an OBJ or PLY mesh, or the pair <prefix>.vbo.bin and
+// <prefix>.ibo.bin; the defaults are the files the renderer loads.
+
+namespace {
+    using namespace dragiyski::raytrace;
+
+    bvh::Bounds nodeBounds(const bvh::Node &node) {
+        bvh::Bounds bounds;
+        std::copy(std::begin(node.min), std::end(node.min), std::begin(bounds.min));
+        std::copy(std::begin(node.max), std::end(node.max), std::begin(bounds.max));
+        return bounds;
+    }
+
+    nlohmann::json inspect(const bvh::Tree &tree, double build_time) {
+        auto root_area = nodeBounds(tree.nodes[0]).area();
+        double sah_cost = 0.0;
+        double overlap_area = 0.0;
+        double overlap_ratio = 0.0;
+        std::size_t interior_count = 0;
+        std::size_t leaf_count = 0;
+        unsigned max_depth = 0;
+        double depth_sum = 0.0;
+        std::map<std::string, std::size_t> leaf_sizes;
+
+        // Depth first from the root; the tree may be in any order.
+        std::vector<std::pair<GLuint, unsigned>> stack = {{0, 0}};
+        while (!stack.empty()) {
+            auto [index, depth] = stack.back();
+            stack.pop_back();
+            const auto &node = tree.nodes[index];
+            auto area = nodeBounds(node).area();
+            auto relative_area = root_area > 0.0f ? area / root_area : 0.0f;
+            if (node.count == 0 && !tree.references.empty()) {
+                ++interior_count;
+                sah_cost += bvh::cost_traversal * relative_area;
+                auto overlap = nodeBounds(tree.nodes[node.first]).intersect(nodeBounds(tree.nodes[node.first + 1])).area();
+                overlap_area += overlap;
+                overlap_ratio += area > 0.0f ? overlap / area : 0.0f;
+                stack.emplace_back(node.first + 1, depth + 1);
+                stack.emplace_back(node.first, depth + 1);
+            } else {
+                ++leaf_count;
+                sah_cost += bvh::cost_intersection * static_cast<double>(node.count) * relative_area;
+                max_depth = std::max(max_depth, depth);
+                depth_sum += depth;
+                ++leaf_sizes[std::to_string(node.count)];
+            }
+        }
+
+        return {
+            {"build_time_ms", build_time},
+            {"nodes", tree.nodes.size()},
+            {"references", tree.references.size()},
+            {"memory_bytes", tree.nodes.size() * sizeof(bvh::Node) + tree.references.size() * sizeof(GLuint)},
+            {"sah_cost", sah_cost},
+            {"depth", {{"max", max_depth}, {"average", leaf_count > 0 ? depth_sum / static_cast<double>(leaf_count) : 0.0}}},
+            {"leaves", leaf_count},
+            {"leaf_size_histogram", leaf_sizes},
+            // Overlap of sibling boxes: the average fraction of the parent and the total relative to the root.
+            {"overlap", {
+                {"sibling_average", interior_count > 0 ? overlap_ratio / static_cast<double>(interior_count) : 0.0},
+                {"total_relative_to_root", root_area > 0.0f ? overlap_area / root_area : 0.0},
+            }},
+        };
+    }
+
+    nlohmann::json inspect(const grid::Grid &grid, double build_time) {
+        auto cell_count = grid.cells.size() - 1;
+        std::size_t empty_count = 0;
+        GLuint max_references = 0;
+        for (std::size_t cell = 0; cell < cell_count; ++cell) {
+            auto count = grid.cells[cell + 1] - grid.cells[cell];
+            empty_count += count == 0 ? 1 : 0;
+            max_references = std::max(max_references, count);
+        }
+        auto occupied_count = cell_count - empty_count;
+        return {
+            {"build_time_ms", build_time},
+            {"resolution", {grid.resolution[0], grid.resolution[1], grid.resolution[2]}},
+            {"cells", cell_count},
+            {"references", grid.references.size()},
+            {"memory_bytes", grid.cells.size() * sizeof(GLuint) + grid.references.size() * sizeof(GLuint)},
+            {"empty_cell_fraction", cell_count > 0 ? static_cast<double>(empty_count) / static_cast<double>(cell_count) : 0.0},
+            {"references_per_occupied_cell", {
+                {"average", occupied_count > 0 ? static_cast<double>(grid.references.size()) / static_cast<double>(occupied_count) : 0.0},
+                {"max", max_references},
+            }},
+        };
+    }
+
+    nlohmann::json inspect(const scene::Meshlets &meshlets, double build_time) {
+        std::size_t triangle_count = 0;
+        std::size_t vertex_count = 0;
+        for (const auto &meshlet : meshlets.table) {
+            triangle_count += meshlet.triangle_count;
+            vertex_count += meshlet.vertex_count;
+        }
+        auto meshlet_count = meshlets.table.size();
+        return {
+            {"build_time_ms", build_time},
+            {"meshlets", meshlet_count},
+            {"memory_bytes", meshlets.table.size_bytes() + meshlets.data.size_bytes()},
+            // Indices of the same triangles as a plain index buffer, what the meshlets replace.
+            {"triangle_index_bytes", triangle_count * sizeof(scene::Triangle)},
+            {"per_meshlet", {
+                {"triangles", meshlet_count > 0 ? static_cast<double>(triangle_count) / static_cast<double>(meshlet_count) : 0.0},
+                {"vertices", meshlet_count > 0 ? static_cast<double>(vertex_count) / static_cast<double>(meshlet_count) : 0.0},
+            }},
+        };
+    }
+
+    nlohmann::json inspect(const scene::Clusters &clusters, double build_time) {
+        std::size_t max_references = 0;
+        for (const auto &cluster : clusters.table) {
+            max_references = std::max<std::size_t>(max_references, cluster.reference_count);
+        }
+        auto cluster_count = clusters.table.size();
+        return {
+            {"build_time_ms", build_time},
+            {"clusters", cluster_count},
+            {"vertices", clusters.vertices.size()},
+            {"triangles", clusters.triangles.size()},
+            {"nodes", clusters.nodes.size()},
+            {"references", clusters.references.size()},
+            {"memory_bytes", clusters.table.size_bytes() + clusters.vertices.size_bytes() + clusters.triangles.size_bytes() + clusters.nodes.size_bytes() + clusters.references.size_bytes()},
+            {"references_per_cluster", {
+                {"average", cluster_count > 0 ? static_cast<double>(clusters.references.size()) / static_cast<double>(cluster_count) : 0.0},
+                {"max", max_references},
+            }},
+        };
+    }
+
+    template<typename Build>
+    nlohmann::json measure(const Build &build) {
+        auto start = std::chrono::steady_clock::now();
+        auto structure = build();
+        auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+        return inspect(structure, duration.count());
+    }
+
+    float parseFloat(const std::string &name, const std::string &value) {
+        try {
+            std::size_t length;
+            auto result = std::stof(value, &length);
+            if (length == value.size() && result >= 0.0f) {
+                return result;
+            }
+        } catch (const std::logic_error &) {
+        }
+        throw std::invalid_argument("Invalid value for " + name + ": " + value);
+    }
+
+    std::size_t parseSize(const std::string &name, const std::string &value) {
+        try {
+            std::size_t length;
+            auto result = std::stoull(value, &length);
+            if (length == value.size()) {
+                return result;
+            }
+        } catch (const std::logic_error &) {
+        }
+        throw std::invalid_argument("Invalid value for " + name + ": " + value);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    std::filesystem::path projectDir(PROJECT_SOURCE_DIR);
+    auto model = std::filesystem::resolve("var/models/cube", projectDir);
+    auto spheres = std::filesystem::resolve("var/models/spheres.bin", projectDir);
+    float alpha = 1e-5f;
+    float density = 4.0f;
+    std::size_t meshlet_size = 128;
+    std::size_t cluster_size = 4096;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string name = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + name);
+            }
+            std::string value = argv[++i];
+            if (name == "--model") {
+                model = value;
+            } else if (name == "--spheres") {
+                spheres = value;
+            } else if (name == "--sbvh-alpha") {
+                alpha = parseFloat(name, value);
+            } else if (name == "--grid-density") {
+                density = parseFloat(name, value);
+                if (density == 0.0f) {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + value);
+                }
+            } else if (name == "--meshlet-size") {
+                meshlet_size = parseSize(name, value);
+            } else if (name == "--cluster-size") {
+                cluster_size = parseSize(name, value);
+                if (cluster_size == 0) {
+                    throw std::invalid_argument("Invalid value for " + name + ": 0");
+                }
+            } else {
+                throw std::invalid_argument("Unknown option: " + name);
+            }
+        }
+
+        auto scene = scene::open(model, spheres);
+        auto bounds = scene.bounds();
+        auto references = scene.references();
+        nlohmann::json output = {
+            {"model", {
+                {"vertices", scene.vertexCount()},
+                {"triangles", scene.triangles.size()},
+                {"spheres", scene.spheres.size()},
+            }},
+        };
+        output["structures"]["sah"] = measure([&]() {
+            return bvh::build(bounds, references);
+        });
+        output["structures"]["sbvh"] = measure([&]() {
+            return bvh::buildSpatial(bounds, references, [&](std::size_t index, const bvh::Bounds &box) {
+                return scene.clip(index, box);
+            }, alpha);
+        });
+        output["structures"]["sbvh"]["alpha"] = alpha;
+        output["structures"]["grid"] = measure([&]() {
+            return grid::build(bounds, references, density);
+        });
+        output["structures"]["grid"]["density"] = density;
+        output["structures"]["meshlet"] = measure([&]() {
+            return scene::buildMeshlets(scene, meshlet_size);
+        });
+        output["structures"]["meshlet"]["size"] = meshlet_size;
+        // Clusters are cut from the SAH tree, as the renderer does; its build is not part of the time.
+        auto tree = bvh::build(bounds, references);
+        output["structures"]["stream"] = measure([&]() {
+            return scene::buildClusters(scene, tree, cluster_size);
+        });
+        output["structures"]["stream"]["size"] = cluster_size;
+        std::cout << output.dump(4) << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
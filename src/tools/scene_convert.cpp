@@ -0,0 +1,130 @@
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "global.h"
+#include "bvh/bvh.h"
+#include "scene/cluster.h"
+#include "scene/container.h"
+#include "scene/meshlet.h"
+#include "scene/scene.h"
+
+// Packs a model and its spheres into a scene container (.rtscene), with a prebuilt BVH, so that the renderer maps one
+// file and skips the build. With --clusters, the container also holds the clusters of the stream accelerator, of at most
+// that many primitives each, cut from the stored tree (or from a SAH tree that is not stored, with --bvh none). With
+// --meshlets, it holds the meshlets of the meshlet accelerator, of at most that many triangles each.
+//
+// Usage: raytrace-scene-convert --output <file.rtscene> [--model <prefix>] [--spheres <file>] [--bvh sah|sbvh|none]
+//                               [--sbvh-alpha <alpha>] [--clusters <size>] [--meshlets <size>]
+// The model is the pair <prefix>.vbo.bin and <prefix>.ibo.bin, a glTF asset, an OBJ or PLY mesh, or another container;
+// the defaults are the files the renderer loads.
+
+namespace {
+    float parseFloat(const std::string &name, const std::string &value) {
+        try {
+            std::size_t length;
+            auto result = std::stof(value, &length);
+            if (length == value.size()) {
+                return result;
+            }
+        } catch (const std::logic_error &) {
+        }
+        throw std::invalid_argument("Invalid value for " + name + ": " + value);
+    }
+
+    std::size_t parseSize(const std::string &name, const std::string &value) {
+        try {
+            std::size_t length;
+            auto result = std::stoull(value, &length);
+            if (length == value.size()) {
+                return result;
+            }
+        } catch (const std::logic_error &) {
+        }
+        throw std::invalid_argument("Invalid value for " + name + ": " + value);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    using namespace dragiyski::raytrace;
+    std::filesystem::path projectDir(PROJECT_SOURCE_DIR);
+    auto model = std::filesystem::resolve("var/models/cube", projectDir);
+    auto spheres = std::filesystem::resolve("var/models/spheres.bin", projectDir);
+    std::filesystem::path output;
+    std::string build = "sah";
+    float alpha = 1e-5f;
+    std::size_t clusterSize = 0;
+    std::size_t meshletSize = 0;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string name = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + name);
+            }
+            std::string value = argv[++i];
+            if (name == "--model") {
+                model = value;
+            } else if (name == "--spheres") {
+                spheres = value;
+            } else if (name == "--output") {
+                output = value;
+            } else if (name == "--bvh") {
+                if (value != "sah" && value != "sbvh" && value != "none") {
+                    throw std::invalid_argument("Invalid value for " + name + ": " + value);
+                }
+                build = value;
+            } else if (name == "--sbvh-alpha") {
+                alpha = parseFloat(name, value);
+            } else if (name == "--clusters") {
+                clusterSize = parseSize(name, value);
+            } else if (name == "--meshlets") {
+                meshletSize = parseSize(name, value);
+            } else {
+                throw std::invalid_argument("Unknown option: " + name);
+            }
+        }
+        if (output.empty()) {
+            throw std::invalid_argument("Missing --output");
+        }
+
+        auto scene = scene::open(model, spheres);
+        scene.bvh = {};
+        scene.bvh_spatial = build == "sbvh";
+        if (build != "none") {
+            auto bounds = scene.bounds();
+            auto references = scene.references();
+            auto start = std::chrono::steady_clock::now();
+            if (scene.bvh_spatial) {
+                scene.bvh = bvh::buildSpatial(bounds, references, [&](std::size_t index, const bvh::Bounds &box) {
+                    return scene.clip(index, box);
+                }, alpha);
+            } else {
+                scene.bvh = bvh::build(bounds, references);
+            }
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            std::cerr << "[bvh]: " << build << ", " << scene.bvh.nodes.size() << " nodes, " << scene.bvh.references.size()
+                      << " references, " << duration.count() << " ms" << std::endl;
+        }
+        if (clusterSize > 0) {
+            auto start = std::chrono::steady_clock::now();
+            scene.clusters = scene::buildClusters(scene, build != "none" ? scene.bvh : bvh::build(scene.bounds(), scene.references()), clusterSize);
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            std::cerr << "[clusters]: " << scene.clusters.table.size() << " clusters, " << scene.clusters.vertices.size()
+                      << " vertices, " << scene.clusters.triangles.size() << " triangles, " << duration.count() << " ms" << std::endl;
+        }
+        if (meshletSize > 0) {
+            auto start = std::chrono::steady_clock::now();
+            scene.meshlets = scene::buildMeshlets(scene, meshletSize);
+            auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            std::cerr << "[meshlets]: " << scene.meshlets.table.size() << " meshlets, "
+                      << scene.meshlets.table.size_bytes() + scene.meshlets.data.size_bytes() << " bytes of indices, " << duration.count() << " ms" << std::endl;
+        }
+        scene::container::write(output, scene);
+        std::cerr << "[scene]: " << scene.vertexCount() << " vertices, " << scene.triangles.size() << " triangles, "
+                  << scene.spheres.size() << " spheres, " << std::filesystem::file_size(output) << " bytes" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
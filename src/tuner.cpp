@@ -0,0 +1,77 @@
+#include "tuner.h"
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+
+namespace dragiyski::raytrace::tuner {
+    const std::vector<local_size> candidates = {
+        {4, 4},
+        {8, 4},
+        {8, 8},
+        {16, 8},
+        {8, 16},
+        {16, 16},
+        {32, 4},
+        {32, 8},
+        {64, 1},
+    };
+
+    std::filesystem::path defaultCachePath() {
+        std::filesystem::path base;
+        if (auto xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') {
+            base = xdg;
+        } else if (auto home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+            base = std::filesystem::path(home) / ".cache";
+        } else {
+            base = std::filesystem::temp_directory_path();
+        }
+        return base / "raytrace" / "workgroup-size.json";
+    }
+
+    Cache::Cache(std::filesystem::path path) : m_path(std::move(path)), m_data(nlohmann::json::object()) {
+        m_key = std::string(reinterpret_cast<const char *>(glGetString(GL_RENDERER))) + " | " + reinterpret_cast<const char *>(glGetString(GL_VERSION));
+        std::ifstream file(m_path);
+        if (!file) {
+            return;
+        }
+        try {
+            m_data = nlohmann::json::parse(file);
+        } catch (const nlohmann::json::exception &e) {
+            // A broken cache only costs a re-tune, it must not prevent startup.
+            fprintf(stderr, "[tuner]: ignoring %s: %s\n", m_path.c_str(), e.what());
+        }
+        if (!m_data.is_object()) {
+            m_data = nlohmann::json::object();
+        }
+    }
+
+    std::optional<local_size> Cache::find(const std::string &kernel) const {
+        auto device = m_data.find(m_key);
+        if (device == m_data.end() || !device->is_object()) {
+            return std::nullopt;
+        }
+        auto entry = device->find(kernel);
+        if (entry == device->end() || !entry->is_array() || entry->size() != 2 || !(*entry)[0].is_number_unsigned() || !(*entry)[1].is_number_unsigned()) {
+            return std::nullopt;
+        }
+        return local_size{(*entry)[0].get<GLuint>(), (*entry)[1].get<GLuint>()};
+    }
+
+    void Cache::store(const std::string &kernel, const local_size &size) {
+        m_data[m_key][kernel] = {size[0], size[1]};
+    }
+
+    void Cache::save() const {
+        try {
+            std::filesystem::create_directories(m_path.parent_path());
+            std::ofstream file;
+            file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+            file.open(m_path);
+            file << m_data.dump(4) << std::endl;
+        } catch (const std::exception &e) {
+            // An unwritable cache (read-only home, full disk) only costs a re-tune on the next launch.
+            fprintf(stderr, "[tuner]: cannot save %s: %s\n", m_path.c_str(), e.what());
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef RAYTRACE_TUNER_H
+#define RAYTRACE_TUNER_H
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <GL/gl.h>
+#include <nlohmann/json.hpp>
+
+namespace dragiyski::raytrace::tuner {
+    typedef std::array<GLuint, 2> local_size;
+
+    /**
+     * Local sizes benchmarked for every per-pixel kernel.
+     */
+    extern const std::vector<local_size> candidates;
+
+    /**
+     * Default location of the cache: $XDG_CACHE_HOME/raytrace (or ~/.cache/raytrace).
+     */
+    std::filesystem::path defaultCachePath();
+
+    /**
+     * Persisted winners of the workgroup size benchmark.
+     * Entries are keyed by GL_RENDERER and GL_VERSION of the current context, so a driver or GPU change re-tunes.
+     */
+    class Cache {
+    private:
+        std::filesystem::path m_path;
+        std::string m_key;
+        nlohmann::json m_data;
+    public:
+        explicit Cache(std::filesystem::path path);
+    public:
+        [[nodiscard]] std::optional<local_size> find(const std::string &kernel) const;
+        void store(const std::string &kernel, const local_size &size);
+        /**
+         * Writes the cache back. Failure is reported on stderr and otherwise ignored.
+         */
+        void save() const;
+    };
+}
+
+#endif //RAYTRACE_TUNER_H
@@ -0,0 +1,15 @@
+// Scene queries of the tracing kernels. The host selects the acceleration structure (see src/accelerator), which binds
+// its buffers from binding 3 and provides
+//     Hit traceClosest(vec3 origin, vec3 direction, float tMax);
+//     bool traceAny(vec3 origin, vec3 direction, float tMax);
+// Requires scene.glsl and primitive.glsl.
+
+#if defined(ACCELERATOR_GRID)
+#include "grid.glsl"
+#elif defined(ACCELERATOR_LINEAR)
+#include "linear.glsl"
+#elif defined(ACCELERATOR_MESHLET)
+#include "meshlet.glsl"
+#else
+#include "bvh.glsl"
+#endif
@@ -0,0 +1,38 @@
+// Screen tiles with the list of primitives that may be visible in each, for --primary binned. The lists are rebuilt
+// every frame: bin_build.glsl counts the tiles each primitive covers, bin_scan.glsl allocates the lists from a prefix
+// sum of the counts and bin_build.glsl (with BIN_FILL) appends the primitive references.
+//
+// A list that does not fit into the `binReferences` capacity is not written; the pixels of its tile trace through the
+// accelerator instead, and the host grows the buffer for the next frame.
+
+// Edge of a tile, in pixels.
+#ifndef BIN_SIZE
+#define BIN_SIZE 16
+#endif
+
+struct Bin {
+    // First reference of the list in binReferences.
+    uint offset;
+    // References in the list; while filling, the ones appended so far.
+    uint count;
+};
+
+layout(std430, binding = 6) buffer BinBuffer {
+    // References in all lists, whether they fit or not.
+    uint binTotal;
+    Bin bins[];
+};
+
+layout(std430, binding = 7) buffer BinReferenceBuffer {
+    uint binReferences[];
+};
+
+uniform uint binCapacity;
+
+ivec2 binGrid(ivec2 screenSize) {
+    return (screenSize + BIN_SIZE - 1) / BIN_SIZE;
+}
+
+uint binIndex(ivec2 tile, ivec2 screenSize) {
+    return uint(tile.y * binGrid(screenSize).x + tile.x);
+}
@@ -0,0 +1,96 @@
+#version 460 core
+
+// One invocation per primitive: triangles first, then spheres. Without BIN_FILL, counts the primitive in every tile
+// it may cover; with BIN_FILL, appends its reference to the list of those tiles.
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+#include "scene.glsl"
+#include "bin.glsl"
+
+uniform uint triangleCount;
+uniform uint sphereCount;
+uniform ivec2 screenSize;
+
+// Clip transform of the visibility buffer: the ray of pixel p goes through the point that lands at the window
+// coordinate p + 0.5, w is the distance along the view direction.
+uniform mat4 viewProjection;
+
+// Adds the corner to the window bounds of the primitive. Returns whether it is in front of the eye.
+bool project(vec3 corner, inout vec2 windowMin, inout vec2 windowMax) {
+    vec4 clip = viewProjection * vec4(corner, 1.0);
+    if (clip.w <= 0.0) {
+        return false;
+    }
+    vec2 window = (clip.xy / clip.w * 0.5 + 0.5) * vec2(screenSize);
+    windowMin = min(windowMin, window);
+    windowMax = max(windowMax, window);
+    return true;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= triangleCount + sphereCount) {
+        return;
+    }
+
+    // Triangles by their corners, spheres by the corners of their box; the hull of the corners covers the primitive.
+    uint reference;
+    vec3 corners[8];
+    uint cornerCount;
+    if (index < triangleCount) {
+        reference = index;
+        for (uint corner = 0; corner < 3; ++corner) {
+            corners[corner] = vertexLocation(triangleVertex(index, corner));
+        }
+        cornerCount = 3;
+    } else {
+        reference = (index - triangleCount) | REFERENCE_SPHERE;
+        Sphere sphere = spheres[index - triangleCount];
+        for (uint corner = 0; corner < 8; ++corner) {
+            vec3 side = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+            corners[corner] = sphere.center + sphere.radius * side;
+        }
+        cornerCount = 8;
+    }
+
+    vec2 windowMin = vec2(3.0e38);
+    vec2 windowMax = vec2(-3.0e38);
+    uint inFront = 0;
+    for (uint corner = 0; corner < cornerCount; ++corner) {
+        inFront += uint(project(corners[corner], windowMin, windowMax));
+    }
+    // Camera rays only go forward: a primitive entirely behind the eye is never hit, one that reaches behind it has no
+    // bounded projection and may be hit anywhere.
+    if (inFront == 0) {
+        return;
+    }
+    ivec2 first = ivec2(0);
+    ivec2 last = screenSize - 1;
+    if (inFront == cornerCount) {
+        // A pixel of margin around the pixels whose rays go through the bounds, for the rounding of the projection.
+        // Corners close to the eye plane project far outside, so the bounds are clamped before they become integers.
+        vec2 screenMax = vec2(screenSize);
+        first = max(first, ivec2(clamp(floor(windowMin - 0.5) - 1.0, vec2(-1.0), screenMax)));
+        last = min(last, ivec2(clamp(floor(windowMax - 0.5) + 1.0, vec2(-1.0), screenMax)));
+    }
+    if (any(greaterThan(first, last))) {
+        return;
+    }
+
+    first /= BIN_SIZE;
+    last /= BIN_SIZE;
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            uint bin = binIndex(ivec2(x, y), screenSize);
+#ifdef BIN_FILL
+            uint slot = bins[bin].offset + atomicAdd(bins[bin].count, 1u);
+            if (slot < binCapacity) {
+                binReferences[slot] = reference;
+            }
+#else
+            atomicAdd(bins[bin].count, 1u);
+#endif
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#version 460 core
+
+// Exclusive prefix sum of the bin counts, in a single work group: every invocation sums a run of consecutive bins,
+// the work group scans the run sums in shared memory, then every invocation writes the offsets of its run. The counts
+// are reset, so that bin_build.glsl can use them as the fill cursors.
+
+#define SCAN_SIZE 256
+
+layout(local_size_x = SCAN_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+#include "bin.glsl"
+
+uniform ivec2 screenSize;
+
+shared uint runSum[SCAN_SIZE];
+
+void main() {
+    ivec2 grid = binGrid(screenSize);
+    uint binCount = uint(grid.x * grid.y);
+    uint local = gl_LocalInvocationIndex;
+    uint runLength = (binCount + SCAN_SIZE - 1) / SCAN_SIZE;
+    uint begin = min(local * runLength, binCount);
+    uint end = min(begin + runLength, binCount);
+
+    uint sum = 0;
+    for (uint bin = begin; bin < end; ++bin) {
+        sum += bins[bin].count;
+    }
+    runSum[local] = sum;
+    barrier();
+
+    // Inclusive Hillis-Steele scan of the run sums.
+    for (uint step = 1; step < SCAN_SIZE; step <<= 1) {
+        uint previous = local >= step ? runSum[local - step] : 0;
+        barrier();
+        runSum[local] += previous;
+        barrier();
+    }
+
+    uint offset = runSum[local] - sum;
+    for (uint bin = begin; bin < end; ++bin) {
+        uint count = bins[bin].count;
+        bins[bin].offset = offset;
+        bins[bin].count = 0;
+        offset += count;
+    }
+    if (local == SCAN_SIZE - 1) {
+        binTotal = runSum[local];
+    }
+}
@@ -0,0 +1,56 @@
+#version 460 core
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r32f, binding = 2) uniform image2DRect image_depth;
+
+#include "camera.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "accelerator.glsl"
+#include "gbuffer.glsl"
+#include "bin.glsl"
+
+// Closest hit of a camera ray against the primitives binned to its screen tile (see bin.glsl). Neighbouring pixels
+// read the same list, so its references and primitives stay in cache. Tiles with more than binLimit primitives, like
+// the ones along a horizon of dense geometry, cost more to test than to traverse, so they trace instead.
+
+uniform uint binLimit;
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, screenSize))) {
+        return;
+    }
+    vec3 rayOrigin = cameraOrigin;
+    vec3 rayDirection = cameraRay(pixel);
+    float tMax = DEPTH_FAR;
+
+    Bin bin = bins[binIndex(pixel / BIN_SIZE, screenSize)];
+    Hit hit;
+    if (bin.count > binLimit || bin.offset + bin.count > binCapacity) {
+        hit = traceClosest(rayOrigin, rayDirection, tMax);
+    } else {
+        hit.t = tMax;
+        hit.reference = NO_HIT;
+        hit.barycentric = vec2(0.0);
+        for (uint i = bin.offset; i < bin.offset + bin.count; ++i) {
+            uint reference = binReferences[i];
+            float t;
+            vec2 barycentric;
+            if (intersectPrimitive(reference, rayOrigin, rayDirection, hit.t, t, barycentric)) {
+                hit.t = t;
+                hit.reference = reference;
+                hit.barycentric = barycentric;
+            }
+        }
+    }
+    if (hit.reference == NO_HIT) {
+        storeMiss(pixel);
+        return;
+    }
+
+    storeHit(pixel, rayOrigin, rayDirection, hit);
+}
@@ -0,0 +1,90 @@
+#version 460 core
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r32f, binding = 2) uniform image2DRect image_depth;
+
+#include "camera.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "gbuffer.glsl"
+
+// Closest hit without an acceleration structure, for scenes too small to profit from a BVH.
+// The work group loads one batch of primitives into shared memory (one primitive per invocation), then every pixel of
+// the tile tests its ray against the whole batch before the next batch is loaded.
+#define BATCH_SIZE (LOCAL_SIZE_X * LOCAL_SIZE_Y)
+
+// The storage buffers always hold at least one element, so the counts come from the host.
+uniform uint triangleCount;
+uniform uint sphereCount;
+
+shared vec3 batchTriangle[BATCH_SIZE][3];
+shared vec4 batchSphere[BATCH_SIZE];
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    // Invocations outside of the screen still load their share of every batch, so they cannot return early.
+    bool inside = all(lessThan(pixel, imageSize(image_depth)));
+    uint local = gl_LocalInvocationIndex;
+
+    vec3 rayOrigin = vec3(0.0);
+    vec3 rayDirection = vec3(0.0, 0.0, -1.0);
+    Hit hit;
+    hit.t = 0.0;
+    hit.reference = NO_HIT;
+    hit.barycentric = vec2(0.0);
+    if (inside) {
+        rayOrigin = cameraOrigin;
+        rayDirection = cameraRay(pixel);
+        hit.t = DEPTH_FAR;
+    }
+
+    for (uint base = 0; base < triangleCount; base += BATCH_SIZE) {
+        if (base + local < triangleCount) {
+            uint index = base + local;
+            batchTriangle[local][0] = vertexLocation(triangleVertex(index, 0));
+            batchTriangle[local][1] = vertexLocation(triangleVertex(index, 1));
+            batchTriangle[local][2] = vertexLocation(triangleVertex(index, 2));
+        }
+        barrier();
+        uint count = min(BATCH_SIZE, triangleCount - base);
+        for (uint i = 0; inside && i < count; ++i) {
+            float t;
+            vec2 barycentric;
+            if (intersectTriangle(rayOrigin, rayDirection, batchTriangle[i][0], batchTriangle[i][1], batchTriangle[i][2], hit.t, t, barycentric)) {
+                hit.t = t;
+                hit.reference = base + i;
+                hit.barycentric = barycentric;
+            }
+        }
+        barrier();
+    }
+
+    for (uint base = 0; base < sphereCount; base += BATCH_SIZE) {
+        if (base + local < sphereCount) {
+            batchSphere[local] = vec4(spheres[base + local].center, spheres[base + local].radius);
+        }
+        barrier();
+        uint count = min(BATCH_SIZE, sphereCount - base);
+        for (uint i = 0; inside && i < count; ++i) {
+            float t;
+            if (intersectSphere(rayOrigin, rayDirection, batchSphere[i].xyz, batchSphere[i].w, hit.t, t)) {
+                hit.t = t;
+                hit.reference = (base + i) | REFERENCE_SPHERE;
+                hit.barycentric = vec2(0.0);
+            }
+        }
+        barrier();
+    }
+
+    if (!inside) {
+        return;
+    }
+    if (hit.reference == NO_HIT) {
+        storeMiss(pixel);
+        return;
+    }
+    storeHit(pixel, rayOrigin, rayDirection, hit);
+}
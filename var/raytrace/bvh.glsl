@@ -0,0 +1,206 @@
+// BVH traversal over the scene buffers. Requires scene.glsl and primitive.glsl.
+
+// BVH_STACKLESS selects the miss-link layout of bvh::thread, which needs no per-invocation stack. Otherwise the nodes
+// are in the layout of bvh::build and traversal keeps a stack of deferred children.
+
+// Matches bvh::Node on the CPU.
+struct Node {
+    vec3 min;
+    // Interior: index of the left child (the right child follows it), or the miss link with BVH_STACKLESS; leaf: first
+    // reference.
+    uint first;
+    vec3 max;
+    // Number of references in a leaf, 0 for interior nodes.
+    uint count;
+};
+
+layout(std430, binding = 3) readonly buffer NodeBuffer {
+    Node nodes[];
+};
+
+// Matches bvh::max_depth: the builder never creates a tree deeper than the stack.
+#define BVH_STACK_SIZE 32
+
+// 1 + 2 * gamma(3) of Pharr et al., the bound of the rounding error of the slab distances.
+#define BOUNDS_ROUNDING (1.0000004)
+
+// Slab test. On success, tNear is the entry distance, clamped to 0 when the origin is inside the box.
+// tFar is scaled up by a few ulps (Ize, "Robust BVH Ray Traversal", 2013): otherwise rounding rejects rays grazing flat
+// boxes, such as the box of a single axis-aligned triangle, and the edges of a mesh get holes.
+bool intersectBounds(vec3 origin, vec3 inverseDirection, vec3 boundsMin, vec3 boundsMax, float tMax, out float tNear) {
+    vec3 t0 = (boundsMin - origin) * inverseDirection;
+    vec3 t1 = (boundsMax - origin) * inverseDirection;
+    vec3 tSmall = min(t0, t1);
+    vec3 tLarge = max(t0, t1);
+    tNear = max(max(tSmall.x, tSmall.y), max(tSmall.z, 0.0));
+    float tFar = min(min(tLarge.x, tLarge.y), min(tLarge.z, tMax)) * BOUNDS_ROUNDING;
+    return tNear <= tFar;
+}
+
+// Tests the references of a leaf against the ray up to hit.t and records the closest hit; with anyHit, it may stop at
+// the first. Leaf references are primitives, unless the including file defines BVH_CUSTOM_LEAF and intersectLeaf.
+#ifdef BVH_CUSTOM_LEAF
+bool intersectLeaf(uint reference, vec3 origin, vec3 direction, vec3 inverseDirection, bool anyHit, inout Hit hit);
+#else
+bool intersectLeaf(uint reference, vec3 origin, vec3 direction, vec3 inverseDirection, bool anyHit, inout Hit hit) {
+    float t;
+    vec2 barycentric;
+    if (!intersectPrimitive(reference, origin, direction, hit.t, t, barycentric)) {
+        return false;
+    }
+    hit.t = t;
+    hit.reference = reference;
+    hit.barycentric = barycentric;
+    return true;
+}
+#endif
+
+#ifndef BVH_STACKLESS
+
+// Closest hit: children are visited near-first and the ray is shortened with every hit.
+Hit traceClosest(vec3 origin, vec3 direction, float tMax) {
+    Hit hit;
+    hit.t = tMax;
+    hit.reference = NO_HIT;
+    hit.barycentric = vec2(0.0);
+
+    vec3 inverseDirection = 1.0 / direction;
+    float tLeft, tRight;
+    if (!intersectBounds(origin, inverseDirection, nodes[0].min, nodes[0].max, hit.t, tLeft)) {
+        return hit;
+    }
+
+    uint stack[BVH_STACK_SIZE];
+    uint stackSize = 0;
+    uint index = 0;
+    while (true) {
+        Node node = nodes[index];
+        if (node.count == 0) {
+            uint left = node.first;
+            uint right = node.first + 1;
+            bool hitLeft = intersectBounds(origin, inverseDirection, nodes[left].min, nodes[left].max, hit.t, tLeft);
+            bool hitRight = intersectBounds(origin, inverseDirection, nodes[right].min, nodes[right].max, hit.t, tRight);
+            if (hitLeft && hitRight) {
+                if (tRight < tLeft) {
+                    index = right;
+                    stack[stackSize++] = left;
+                } else {
+                    index = left;
+                    stack[stackSize++] = right;
+                }
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                index = hitLeft ? left : right;
+                continue;
+            }
+        } else {
+            for (uint i = node.first; i < node.first + node.count; ++i) {
+                intersectLeaf(references[i], origin, direction, inverseDirection, false, hit);
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        index = stack[--stackSize];
+    }
+    return hit;
+}
+
+// Any hit: no child ordering, traversal ends at the first primitive within tMax.
+bool traceAny(vec3 origin, vec3 direction, float tMax) {
+    Hit hit;
+    hit.t = tMax;
+    vec3 inverseDirection = 1.0 / direction;
+    float tNear;
+    if (!intersectBounds(origin, inverseDirection, nodes[0].min, nodes[0].max, tMax, tNear)) {
+        return false;
+    }
+
+    uint stack[BVH_STACK_SIZE];
+    uint stackSize = 0;
+    uint index = 0;
+    while (true) {
+        Node node = nodes[index];
+        if (node.count == 0) {
+            uint left = node.first;
+            uint right = node.first + 1;
+            bool hitLeft = intersectBounds(origin, inverseDirection, nodes[left].min, nodes[left].max, tMax, tNear);
+            bool hitRight = intersectBounds(origin, inverseDirection, nodes[right].min, nodes[right].max, tMax, tNear);
+            if (hitLeft && hitRight) {
+                index = left;
+                stack[stackSize++] = right;
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                index = hitLeft ? left : right;
+                continue;
+            }
+        } else {
+            for (uint i = node.first; i < node.first + node.count; ++i) {
+                if (intersectLeaf(references[i], origin, direction, inverseDirection, true, hit)) {
+                    return true;
+                }
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        index = stack[--stackSize];
+    }
+    return false;
+}
+
+#else
+
+// Closest hit: nodes are visited in depth-first order, a missed interior node skips its subtree.
+// There is no near-first ordering, so fewer boxes are culled by an early close hit than with the stack.
+Hit traceClosest(vec3 origin, vec3 direction, float tMax) {
+    Hit hit;
+    hit.t = tMax;
+    hit.reference = NO_HIT;
+    hit.barycentric = vec2(0.0);
+
+    vec3 inverseDirection = 1.0 / direction;
+    uint nodeCount = uint(nodes.length());
+    uint index = 0;
+    while (index < nodeCount) {
+        Node node = nodes[index];
+        float tNear;
+        if (!intersectBounds(origin, inverseDirection, node.min, node.max, hit.t, tNear)) {
+            index = node.count == 0 ? node.first : index + 1;
+            continue;
+        }
+        for (uint i = node.first; i < node.first + node.count; ++i) {
+            intersectLeaf(references[i], origin, direction, inverseDirection, false, hit);
+        }
+        ++index;
+    }
+    return hit;
+}
+
+// Any hit: the same walk, ending at the first primitive within tMax.
+bool traceAny(vec3 origin, vec3 direction, float tMax) {
+    Hit hit;
+    hit.t = tMax;
+    vec3 inverseDirection = 1.0 / direction;
+    uint nodeCount = uint(nodes.length());
+    uint index = 0;
+    while (index < nodeCount) {
+        Node node = nodes[index];
+        float tNear;
+        if (!intersectBounds(origin, inverseDirection, node.min, node.max, tMax, tNear)) {
+            index = node.count == 0 ? node.first : index + 1;
+            continue;
+        }
+        for (uint i = node.first; i < node.first + node.count; ++i) {
+            if (intersectLeaf(references[i], origin, direction, inverseDirection, true, hit)) {
+                return true;
+            }
+        }
+        ++index;
+    }
+    return false;
+}
+
+#endif
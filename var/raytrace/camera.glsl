@@ -0,0 +1,33 @@
+// Camera rays (see scene::Camera). The image plane is screenRadius in front of the eye and spans [-viewSize, viewSize];
+// the ray of a pixel goes through its lower left corner. Kernels generate the ray of their pixel themselves, so camera
+// rays never go through memory.
+
+// Matches CameraBlock in src/Screen.cpp (std140, 48 bytes). The roll is in radians.
+layout(std140, binding = 0) uniform Camera {
+    vec3 cameraOrigin;
+    float screenRadius;
+    vec3 cameraDirection;
+    float cameraRoll;
+    vec2 viewSize;
+    ivec2 screenSize;
+};
+
+vec3 cameraRay(ivec2 pixel) {
+    vec2 relCoord = vec2(pixel) / vec2(screenSize);
+    vec2 rectCoord = relCoord * viewSize * 2.0 - viewSize;
+    vec3 flatCoord = vec3(rectCoord, 0.0);
+    vec3 origin = vec3(0.0, 0.0, screenRadius);
+    vec3 cameraRay = flatCoord - origin;
+
+    // Camera space looks down -z with y up: turn it towards cameraDirection, keeping the world y axis up (or -z when
+    // looking straight up or down), and roll it around the direction.
+    vec3 forward = normalize(cameraDirection);
+    vec3 worldUp = abs(forward.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(forward, worldUp));
+    vec3 up = cross(right, forward);
+    float rollCos = cos(cameraRoll);
+    float rollSin = sin(cameraRoll);
+    vec3 rolledRight = rollCos * right + rollSin * up;
+    vec3 rolledUp = rollCos * up - rollSin * right;
+    return normalize(cameraRay.x * rolledRight + cameraRay.y * rolledUp - cameraRay.z * forward);
+}
@@ -0,0 +1,41 @@
+#version 460 core
+
+#include "tile.glsl"
+
+// Primary ray, shadow ray and shading of a pixel in one kernel: the hit stays in registers instead of going through
+// the trace layers, and every pixel is written, so the screen needs no clearing either.
+
+layout(rgba32f, binding = 0) uniform image2DRect image_screen;
+
+layout(binding = 0, offset = 0) uniform atomic_uint shadowRayCount;
+
+#include "shading.glsl"
+#include "camera.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "accelerator.glsl"
+#include "surface.glsl"
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, imageSize(image_screen)))) {
+        return;
+    }
+    vec3 rayOrigin = cameraOrigin;
+    vec3 rayDirection = cameraRay(pixel);
+
+    Hit hit = traceClosest(rayOrigin, rayDirection, uintBitsToFloat(0x7F800000u));
+    if (hit.reference == NO_HIT) {
+        imageStore(image_screen, pixel, vec4(0.0));
+        return;
+    }
+
+    Surface surface = hitSurface(rayOrigin, rayDirection, hit);
+    vec3 hitPoint = rayOrigin + hit.t * rayDirection;
+    vec3 origin = shadowOrigin(hitPoint, surface.normal);
+    atomicCounterIncrement(shadowRayCount);
+    float visibility = traceAny(origin, shadowDirection(origin), 1.0) ? 0.0 : 1.0;
+
+    vec3 color = shade(surface.color.xyz, surface.normal, hitPoint, -rayDirection, visibility);
+    imageStore(image_screen, pixel, vec4(color, 1.0));
+}
@@ -0,0 +1,33 @@
+// Writes the closest hit of a primary ray into the trace layers, the trace index and the depth image.
+// The including kernel declares image_trace, image_trace_index and image_depth. Requires scene.glsl and primitive.glsl.
+// The primary kernel is the first pass of a frame to write them, so it writes every pixel, hit or miss, and nothing
+// has to be cleared before it: primary rays start at DEPTH_FAR instead of the depth image.
+
+#include "surface.glsl"
+
+#define DEPTH_FAR (uintBitsToFloat(0x7F800000u))
+
+// Stores a hit whose attributes are already known. The normal may face either way.
+void storeSurface(ivec2 pixel, vec3 rayOrigin, vec3 rayDirection, float t, uint reference, vec4 color, vec3 normal) {
+    if (dot(rayDirection, normal) > 0.0) {
+        normal = -normal;
+    }
+
+    imageStore(image_trace, ivec3(pixel, 0), color);
+    imageStore(image_trace, ivec3(pixel, 1), vec4(normal, 1.0));
+    imageStore(image_trace, ivec3(pixel, 2), vec4(rayOrigin + t * rayDirection, t));
+    imageStore(image_trace, ivec3(pixel, 3), vec4(-rayDirection, 1.0));
+    imageStore(image_trace_index, pixel, uvec4(reference + 1, 0, 0, 0));
+    imageStore(image_depth, pixel, vec4(t, 0.0, 0.0, 0.0));
+}
+
+// The trace layers keep whatever they held: the passes behind read them only where the trace index is not 0.
+void storeMiss(ivec2 pixel) {
+    imageStore(image_trace_index, pixel, uvec4(0, 0, 0, 0));
+    imageStore(image_depth, pixel, vec4(DEPTH_FAR, 0.0, 0.0, 0.0));
+}
+
+void storeHit(ivec2 pixel, vec3 rayOrigin, vec3 rayDirection, Hit hit) {
+    Surface surface = hitSurface(rayOrigin, rayDirection, hit);
+    storeSurface(pixel, rayOrigin, rayDirection, hit.t, hit.reference, surface.color, surface.normal);
+}
@@ -0,0 +1,113 @@
+// Uniform grid traversal with 3D-DDA (Amanatides and Woo). Requires scene.glsl and primitive.glsl.
+
+// Layout of grid::Grid: cell c references references[cells[c]] up to (excluding) references[cells[c + 1]], where
+// c = x + gridResolution.x * (y + gridResolution.y * z).
+layout(std430, binding = 3) readonly buffer CellBuffer {
+    uint cells[];
+};
+
+uniform vec3 gridMin;
+uniform vec3 gridCellSize;
+uniform ivec3 gridResolution;
+
+// State of a ray walking the cells, front to back.
+struct GridWalk {
+    ivec3 cell;
+    ivec3 stepDirection;
+    // Distance along the ray to the next cell boundary of each axis, and between two boundaries of the same axis.
+    vec3 tNext;
+    vec3 tDelta;
+};
+
+// Sets up the walk at the cell where the ray enters the grid, or returns false when the ray misses it within tMax.
+bool gridEnter(vec3 origin, vec3 direction, float tMax, out GridWalk walk) {
+    vec3 inverseDirection = 1.0 / direction;
+    vec3 gridMax = gridMin + gridCellSize * vec3(gridResolution);
+    vec3 t0 = (gridMin - origin) * inverseDirection;
+    vec3 t1 = (gridMax - origin) * inverseDirection;
+    vec3 tSmall = min(t0, t1);
+    vec3 tLarge = max(t0, t1);
+    float tEnter = max(max(tSmall.x, tSmall.y), max(tSmall.z, 0.0));
+    // Conservative like intersectBounds in bvh.glsl, so rays grazing the grid bounds are not lost.
+    float tExit = min(min(tLarge.x, tLarge.y), min(tLarge.z, tMax)) * 1.0000004;
+    if (tEnter > tExit) {
+        return false;
+    }
+    vec3 entry = origin + tEnter * direction;
+    walk.cell = clamp(ivec3(floor((entry - gridMin) / gridCellSize)), ivec3(0), gridResolution - 1);
+    walk.stepDirection = ivec3(sign(direction));
+    // An axis the ray is parallel to never reaches its next boundary.
+    vec3 boundary = gridMin + (vec3(walk.cell) + step(0.0, direction)) * gridCellSize;
+    walk.tNext = mix((boundary - origin) * inverseDirection, vec3(1e30), equal(direction, vec3(0.0)));
+    walk.tDelta = mix(gridCellSize * abs(inverseDirection), vec3(1e30), equal(direction, vec3(0.0)));
+    return true;
+}
+
+// Distance at which the ray leaves the current cell.
+float gridCellExit(GridWalk walk) {
+    return min(min(walk.tNext.x, walk.tNext.y), walk.tNext.z);
+}
+
+// Moves to the neighbour across the nearest boundary, returns false when that leaves the grid.
+bool gridStep(inout GridWalk walk) {
+    int axis = walk.tNext.x < walk.tNext.y ? (walk.tNext.x < walk.tNext.z ? 0 : 2) : (walk.tNext.y < walk.tNext.z ? 1 : 2);
+    walk.cell[axis] += walk.stepDirection[axis];
+    walk.tNext[axis] += walk.tDelta[axis];
+    return walk.cell[axis] >= 0 && walk.cell[axis] < gridResolution[axis];
+}
+
+uint gridCellIndex(ivec3 cell) {
+    return uint(cell.x + gridResolution.x * (cell.y + gridResolution.y * cell.z));
+}
+
+// Closest hit: a primitive may extend past the current cell, so its hit only ends the walk once the ray has left
+// every cell in front of it.
+Hit traceClosest(vec3 origin, vec3 direction, float tMax) {
+    Hit hit;
+    hit.t = tMax;
+    hit.reference = NO_HIT;
+    hit.barycentric = vec2(0.0);
+
+    GridWalk walk;
+    if (!gridEnter(origin, direction, hit.t, walk)) {
+        return hit;
+    }
+    do {
+        uint cell = gridCellIndex(walk.cell);
+        for (uint i = cells[cell]; i < cells[cell + 1]; ++i) {
+            float t;
+            vec2 barycentric;
+            if (intersectPrimitive(references[i], origin, direction, hit.t, t, barycentric)) {
+                hit.t = t;
+                hit.reference = references[i];
+                hit.barycentric = barycentric;
+            }
+        }
+        if (hit.t <= gridCellExit(walk)) {
+            break;
+        }
+    } while (gridStep(walk));
+    return hit;
+}
+
+// Any hit: the first primitive within tMax in any cell along the ray.
+bool traceAny(vec3 origin, vec3 direction, float tMax) {
+    GridWalk walk;
+    if (!gridEnter(origin, direction, tMax, walk)) {
+        return false;
+    }
+    do {
+        uint cell = gridCellIndex(walk.cell);
+        for (uint i = cells[cell]; i < cells[cell + 1]; ++i) {
+            float t;
+            vec2 barycentric;
+            if (intersectPrimitive(references[i], origin, direction, tMax, t, barycentric)) {
+                return true;
+            }
+        }
+        if (tMax <= gridCellExit(walk)) {
+            break;
+        }
+    } while (gridStep(walk));
+    return false;
+}
@@ -0,0 +1,32 @@
+// No acceleration structure: every query tests all references. Requires scene.glsl and primitive.glsl.
+
+// The reference buffer always holds at least one element, so the count comes from the host.
+uniform uint referenceCount;
+
+Hit traceClosest(vec3 origin, vec3 direction, float tMax) {
+    Hit hit;
+    hit.t = tMax;
+    hit.reference = NO_HIT;
+    hit.barycentric = vec2(0.0);
+    for (uint i = 0; i < referenceCount; ++i) {
+        float t;
+        vec2 barycentric;
+        if (intersectPrimitive(references[i], origin, direction, hit.t, t, barycentric)) {
+            hit.t = t;
+            hit.reference = references[i];
+            hit.barycentric = barycentric;
+        }
+    }
+    return hit;
+}
+
+bool traceAny(vec3 origin, vec3 direction, float tMax) {
+    for (uint i = 0; i < referenceCount; ++i) {
+        float t;
+        vec2 barycentric;
+        if (intersectPrimitive(references[i], origin, direction, tMax, t, barycentric)) {
+            return true;
+        }
+    }
+    return false;
+}
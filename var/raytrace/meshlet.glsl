@@ -0,0 +1,47 @@
+// BVH over meshlets and spheres (see src/scene/meshlet.h): the traversal of bvh.glsl, whose leaves reference a meshlet
+// or, with REFERENCE_SPHERE, a sphere. A meshlet is culled by its bounds before its triangles are tested.
+// Requires scene.glsl, compiled with ACCELERATOR_MESHLET, and primitive.glsl.
+
+#define BVH_CUSTOM_LEAF
+#include "bvh.glsl"
+
+bool intersectLeaf(uint reference, vec3 origin, vec3 direction, vec3 inverseDirection, bool anyHit, inout Hit hit) {
+    float t;
+    vec2 barycentric;
+    if ((reference & REFERENCE_SPHERE) != 0) {
+        if (!intersectPrimitive(reference, origin, direction, hit.t, t, barycentric)) {
+            return false;
+        }
+        hit.t = t;
+        hit.reference = reference;
+        hit.barycentric = barycentric;
+        return true;
+    }
+
+    Meshlet meshlet = meshlets[reference];
+    float tNear;
+    if (!intersectBounds(origin, inverseDirection, meshlet.min, meshlet.max, hit.t, tNear)) {
+        return false;
+    }
+    // The vertex indices of the meshlet are few and shared by its triangles, so they stay in cache across the loop.
+    uint vertices = meshlet.offset;
+    uint first = meshlet.offset + (meshlet.counts & 0xFFFFu);
+    uint count = meshlet.counts >> 16;
+    bool found = false;
+    for (uint i = 0; i < count; ++i) {
+        uint corners = meshletData[first + i];
+        vec3 a = vertexLocation(meshletData[vertices + bitfieldExtract(corners, 0, 8)]);
+        vec3 b = vertexLocation(meshletData[vertices + bitfieldExtract(corners, 8, 8)]);
+        vec3 c = vertexLocation(meshletData[vertices + bitfieldExtract(corners, 16, 8)]);
+        if (intersectTriangle(origin, direction, a, b, c, hit.t, t, barycentric)) {
+            hit.t = t;
+            hit.reference = (reference << 8) | i;
+            hit.barycentric = barycentric;
+            found = true;
+            if (anyHit) {
+                return true;
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,30 @@
+// Intersection of a single primitive reference. Requires scene.glsl.
+
+#include "shape/triangle.glsl"
+#include "shape/sphere.glsl"
+
+#define NO_HIT (0xFFFFFFFFu)
+
+struct Hit {
+    float t;
+    uint reference;
+    vec2 barycentric;
+};
+
+bool intersectPrimitive(uint reference, vec3 origin, vec3 direction, float tMax, out float t, out vec2 barycentric) {
+    uint index = reference & REFERENCE_INDEX;
+    if ((reference & REFERENCE_SPHERE) != 0) {
+        barycentric = vec2(0.0);
+        return intersectSphere(origin, direction, spheres[index].center, spheres[index].radius, tMax, t);
+    }
+    return intersectTriangle(
+        origin,
+        direction,
+        vertexLocation(triangleVertex(index, 0)),
+        vertexLocation(triangleVertex(index, 1)),
+        vertexLocation(triangleVertex(index, 2)),
+        tMax,
+        t,
+        barycentric
+    );
+}
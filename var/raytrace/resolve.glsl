@@ -0,0 +1,64 @@
+#version 460 core
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r32f, binding = 2) uniform image2DRect image_depth;
+layout(r32ui, binding = 3) uniform uimage2DRect image_visibility;
+
+#include "camera.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "accelerator.glsl"
+#include "gbuffer.glsl"
+
+// Closest hit of a primary ray from the visibility buffer (var/visibility): the rasterizer already found the primitive,
+// so the ray only intersects that one to get the distance and barycentrics the G-buffer stores.
+
+void intersectVisible(uint visible, vec3 origin, vec3 direction, inout Hit hit) {
+    float t;
+    vec2 barycentric;
+    if (visible != 0 && intersectPrimitive(visible - 1, origin, direction, hit.t, t, barycentric)) {
+        hit.t = t;
+        hit.reference = visible - 1;
+        hit.barycentric = barycentric;
+    }
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, imageSize(image_depth)))) {
+        return;
+    }
+    uint visible = imageLoad(image_visibility, pixel).x;
+    vec3 rayOrigin = cameraOrigin;
+    vec3 rayDirection = cameraRay(pixel);
+
+    Hit hit;
+    hit.t = DEPTH_FAR;
+    hit.reference = NO_HIT;
+    hit.barycentric = vec2(0.0);
+    intersectVisible(visible, rayOrigin, rayDirection, hit);
+    if (hit.reference == NO_HIT) {
+        // The coverage rules leave out pixel centers exactly on the right or top edge (or corner) of a primitive, which
+        // the ray still hits: a neighbor has that primitive. Loads outside of the image return 0.
+        for (int y = -1; y <= 1; ++y) {
+            for (int x = -1; x <= 1; ++x) {
+                if (x != 0 || y != 0) {
+                    intersectVisible(imageLoad(image_visibility, pixel + ivec2(x, y)).x, rayOrigin, rayDirection, hit);
+                }
+            }
+        }
+    }
+    if (hit.reference == NO_HIT && visible != 0) {
+        // Rounding can make the ray miss a primitive the rasterizer covered: there, the acceleration structure decides.
+        hit = traceClosest(rayOrigin, rayDirection, hit.t);
+    }
+    if (hit.reference == NO_HIT) {
+        storeMiss(pixel);
+        return;
+    }
+
+    storeHit(pixel, rayOrigin, rayDirection, hit);
+}
@@ -0,0 +1,135 @@
+// Scene geometry shared by the tracing kernels. The layouts match Position, Attributes and Sphere on the CPU.
+// Binding 3 belongs to the acceleration structure (see accelerator.glsl), binding 4 holds its primitive references.
+// The attributes have binding 5, except in the streaming kernels: stream.glsl gives it to the cluster tree, and those
+// kernels take the attributes from their slots instead. With ACCELERATOR_MESHLET, the triangles are in the meshlets at
+// bindings 6 and 7 instead.
+
+#ifndef VERTEX_QUANTIZED
+// Scalar arrays keep the std430 layouts identical to the tightly packed Position and Attributes on the CPU.
+struct VertexPosition {
+    float location[3];
+};
+
+struct VertexAttributes {
+    float normal[3];
+    float uv[2];
+};
+#endif
+
+struct Sphere {
+    vec3 center;
+    float radius;
+    vec4 color;
+};
+
+// Vertices are split into two streams: positions, the only part intersection reads, and the attributes of shading.
+#ifdef VERTEX_QUANTIZED
+// Positions come in blocks of VERTEX_BLOCK_SIZE records, each after three records with the minimum and the grid step
+// of its positions (see src/scene/quantize.h).
+#define VERTEX_BLOCK_SIZE (256u)
+#define VERTEX_BLOCK_HEADER (3u)
+
+layout(std430, binding = 0) readonly buffer VertexPositionBuffer {
+    uvec2 positions[];
+};
+
+layout(std430, binding = 5) readonly buffer VertexAttributeBuffer {
+    uvec2 attributes[];
+};
+#else
+layout(std430, binding = 0) readonly buffer VertexPositionBuffer {
+    VertexPosition positions[];
+};
+
+layout(std430, binding = 5) readonly buffer VertexAttributeBuffer {
+    VertexAttributes attributes[];
+};
+#endif
+
+layout(std430, binding = 1) readonly buffer TriangleBuffer {
+    uint triangles[];
+};
+
+layout(std430, binding = 2) readonly buffer SphereBuffer {
+    Sphere spheres[];
+};
+
+layout(std430, binding = 4) readonly buffer ReferenceBuffer {
+    uint references[];
+};
+
+// A reference is a triangle index, or a sphere index when the high bit is set.
+#define REFERENCE_SPHERE (0x80000000u)
+#define REFERENCE_INDEX (0x7FFFFFFFu)
+
+#ifdef ACCELERATOR_MESHLET
+// Matches scene::Meshlet on the CPU: the vertex count is in the low half of `counts`, the triangle count in the high
+// half. Triangle indices are (meshlet << 8) | (index of the triangle in the meshlet).
+struct Meshlet {
+    vec3 min;
+    uint offset;
+    vec3 max;
+    uint counts;
+};
+
+layout(std430, binding = 6) readonly buffer MeshletBuffer {
+    Meshlet meshlets[];
+};
+
+// Per meshlet: its scene vertex indices, then its triangles as three 8-bit indices into them.
+layout(std430, binding = 7) readonly buffer MeshletDataBuffer {
+    uint meshletData[];
+};
+#endif
+
+#ifdef VERTEX_QUANTIZED
+
+vec3 vertexLocation(uint index) {
+    uint block = index / VERTEX_BLOCK_SIZE * (VERTEX_BLOCK_SIZE + VERTEX_BLOCK_HEADER);
+    uvec2 record = positions[block + VERTEX_BLOCK_HEADER + index % VERTEX_BLOCK_SIZE];
+    vec3 steps = vec3(uvec3(record.x & 0xFFFFu, record.x >> 16, record.y));
+    vec3 minimum = uintBitsToFloat(uvec3(positions[block], positions[block + 1u].x));
+    vec3 step = uintBitsToFloat(uvec3(positions[block + 1u].y, positions[block + 2u]));
+    // The step is a power of two: the product is exact and the sum rounds like on the CPU.
+    return minimum + steps * step;
+}
+
+// Octahedral decoding.
+vec3 vertexNormal(uint index) {
+    vec2 encoded = unpackSnorm2x16(attributes[index].x);
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
+
+vec2 vertexUv(uint index) {
+    return unpackHalf2x16(attributes[index].y);
+}
+
+#else
+
+vec3 vertexLocation(uint index) {
+    return vec3(positions[index].location[0], positions[index].location[1], positions[index].location[2]);
+}
+
+vec3 vertexNormal(uint index) {
+    return vec3(attributes[index].normal[0], attributes[index].normal[1], attributes[index].normal[2]);
+}
+
+vec2 vertexUv(uint index) {
+    return vec2(attributes[index].uv[0], attributes[index].uv[1]);
+}
+
+#endif
+
+// Scene vertex at `corner` of triangle `index`.
+uint triangleVertex(uint index, uint corner) {
+#ifdef ACCELERATOR_MESHLET
+    Meshlet meshlet = meshlets[index >> 8];
+    uint corners = meshletData[meshlet.offset + (meshlet.counts & 0xFFFFu) + (index & 0xFFu)];
+    return meshletData[meshlet.offset + bitfieldExtract(corners, int(8 * corner), 8)];
+#else
+    return triangles[3 * index + corner];
+#endif
+}
@@ -0,0 +1,28 @@
+// Direct lighting from the point light: the shadow ray of a surface point and the Phong model.
+
+// Offset of the shadow ray origin along the surface normal, so the ray does not hit the surface it starts from.
+#define SHADOW_BIAS (1e-4)
+
+uniform vec3 lightPosition;
+uniform vec3 lightColor;
+// Ambient, diffuse and specular coefficients, and the shininess exponent.
+uniform vec4 material;
+
+vec3 shadowOrigin(vec3 hitPoint, vec3 N) {
+    return hitPoint + SHADOW_BIAS * N;
+}
+
+// The direction is not normalized: t = 1 is the light itself, so anything beyond it does not cast a shadow.
+vec3 shadowDirection(vec3 origin) {
+    return lightPosition - origin;
+}
+
+// Color of a surface point seen from direction V, lit by `visibility` of the light.
+vec3 shade(vec3 materialColor, vec3 N, vec3 hitPoint, vec3 V, float visibility) {
+    vec3 L = normalize(lightPosition - hitPoint);
+    vec3 R = reflect(-L, N);
+    vec3 color = material.x * materialColor;
+    color += visibility * max(0.0, dot(L, N)) * material.y * materialColor * lightColor;
+    color += visibility * pow(max(0.0, dot(R, V)), material.w) * material.z * lightColor;
+    return color;
+}
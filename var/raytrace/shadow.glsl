@@ -0,0 +1,35 @@
+#version 460 core
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r8, binding = 2) uniform image2DRect image_shadow;
+
+layout(binding = 0, offset = 0) uniform atomic_uint shadowRayCount;
+
+#include "shading.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "accelerator.glsl"
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, imageSize(image_shadow)))) {
+        return;
+    }
+    uint id = imageLoad(image_trace_index, pixel).x;
+    if (id == 0) {
+        return;
+    }
+    vec3 N = imageLoad(image_trace, ivec3(pixel, 1)).xyz;
+    vec3 hitPoint = imageLoad(image_trace, ivec3(pixel, 2)).xyz;
+
+    vec3 origin = shadowOrigin(hitPoint, N);
+    vec3 direction = shadowDirection(origin);
+    atomicCounterIncrement(shadowRayCount);
+
+    // Any occluder is enough: traversal stops at the first one and nothing about it is fetched.
+    float visibility = traceAny(origin, direction, 1.0) ? 0.0 : 1.0;
+    imageStore(image_shadow, pixel, vec4(visibility, 0.0, 0.0, 0.0));
+}
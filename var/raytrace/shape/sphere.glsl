@@ -1,45 +1,31 @@
-#version 460 core
-
-#define PI (3.141592653589793)
-
-layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
-
-layout(rgba32f, binding = 0) uniform image2DArray image_ray;
-layout(rgba32f, binding = 1) uniform image2DArray image_trace;
-layout(r32ui, binding = 2) uniform uimage2DRect image_trace_index;
-
-uniform uint id;
-uniform vec3 position;
-uniform float radius;
-uniform vec3 color;
-
-void main() {
-    vec3 rayOrigin = imageLoad(image_ray, ivec3(gl_WorkGroupID.xy, 0)).xyz;
-    vec3 rayDirection = imageLoad(image_ray, ivec3(gl_WorkGroupID.xy, 1)).xyz;
-
-    vec3 s = rayOrigin - position;
-    float a = dot(rayDirection, rayDirection);
-    float b = 2.0 * dot(rayDirection, s);
+// Ray/sphere intersection in the half-b form.
+// The discriminant is computed from the distance between the center and the ray (instead of b^2 - ac), and the
+// second root comes from Vieta's formula (c / q), so neither suffers from cancellation for small or distant spheres.
+bool intersectSphere(vec3 origin, vec3 direction, vec3 center, float radius, float tMax, out float t) {
+    vec3 s = origin - center;
+    float a = dot(direction, direction);
+    float halfB = dot(s, direction);
     float c = dot(s, s) - radius * radius;
-    float D = b * b - 4.0 * a * c;
+    vec3 perpendicular = s - (halfB / a) * direction;
+    float D = a * (radius * radius - dot(perpendicular, perpendicular));
     if (D < 0.0) {
-        return;
+        return false;
     }
-    float x = (-b - sqrt(D)) / (2.0 * a);
-    if (x < 0.0) {
-        x = (-b + sqrt(D)) / (2.0 * a);
-        if (x < 0.0) {
-            return;
-        }
+    float q = -(halfB + (halfB >= 0.0 ? sqrt(D) : -sqrt(D)));
+    float x0 = c / q;
+    float x1 = q / a;
+    if (x0 > x1) {
+        float x = x0;
+        x0 = x1;
+        x1 = x;
     }
-    vec3 hitPoint = rayOrigin + x * rayDirection;
-    vec3 normal = normalize(hitPoint - position);
-    if(dot(rayDirection, normal) > 0.0) {
-        normal = -normal;
+    if (x0 > 0.0 && x0 < tMax) {
+        t = x0;
+        return true;
     }
-    imageStore(image_trace, ivec3(gl_WorkGroupID.xy, 0), vec4(color, 1.0));
-    imageStore(image_trace, ivec3(gl_WorkGroupID.xy, 1), vec4(normal, 1.0));
-    imageStore(image_trace, ivec3(gl_WorkGroupID.xy, 2), vec4(hitPoint, x));
-    imageStore(image_trace, ivec3(gl_WorkGroupID.xy, 3), vec4(-rayDirection, 1.0));
-    imageStore(image_trace_index, ivec2(gl_WorkGroupID.xy), uvec4(id, 0, 0, 0));
+    if (x1 > 0.0 && x1 < tMax) {
+        t = x1;
+        return true;
+    }
+    return false;
 }
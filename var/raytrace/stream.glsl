@@ -0,0 +1,299 @@
+// Out-of-core traversal of accelerator::Stream. Requires scene.glsl and primitive.glsl.
+//
+// The geometry is split into clusters with a tree each (see src/scene/cluster.h) and only the clusters in the pool are
+// on the GPU. A ray visits the clusters its segment enters in order of entry distance, then index. At the first cluster
+// that is not resident it requests it and stops; its state is kept in `rays` and the next wave, dispatched once the
+// host has loaded the requested clusters, continues after the last cluster the ray tested. The order is total, so no
+// cluster is tested twice or skipped, and the closest hit is the same as with the whole scene resident.
+
+#define NOT_RESIDENT (0xFFFFFFFFu)
+#define NO_CLUSTER (0xFFFFFFFFu)
+
+// Requests of the current wave, collected by the host.
+#define REQUEST_USED (1u)
+#define REQUEST_LOAD (2u)
+
+// Words of a slot before its tree: the index of the first triangle of the cluster, then padding.
+#define SLOT_HEADER (4u)
+
+// Matches bvh::max_depth, for the tree over the clusters and the tree of each cluster.
+#define STREAM_STACK_SIZE 32
+
+// Matches accelerator::Stream::Entry.
+struct Cluster {
+    vec3 min;
+    // Pool slot holding the cluster, or NOT_RESIDENT.
+    uint slot;
+    vec3 max;
+    // REQUEST_USED or REQUEST_LOAD, set by the rays of this wave and cleared by the host.
+    uint request;
+};
+
+// Same layout as Node in bvh.glsl.
+struct Node {
+    vec3 min;
+    uint first;
+    vec3 max;
+    uint count;
+};
+
+// State of a ray between waves.
+struct StreamRay {
+    // Closest hit so far (tMax without one) and its reference, NO_HIT without one.
+    float t;
+    uint reference;
+    // Entry distance and index of the last cluster tested.
+    float resumeT;
+    uint resumeCluster;
+    // Normal at the closest hit, fetched while its cluster was resident.
+    vec3 normal;
+    uint done;
+};
+
+layout(std430, binding = 3) buffer ClusterBuffer {
+    Cluster clusters[];
+};
+
+// Tree over the cluster bounds: leaves are ranges of clusters.
+layout(std430, binding = 5) readonly buffer ClusterNodeBuffer {
+    Node clusterNodes[];
+};
+
+// Fixed-size slots of one cluster each: the header, the tree, then the references, triangles, vertex positions and vertex
+// attributes, like the streams of scene.glsl.
+layout(std430, binding = 6) readonly buffer PoolBuffer {
+    uint pool[];
+};
+
+// One per pixel.
+layout(std430, binding = 7) buffer RayBuffer {
+    StreamRay rays[];
+};
+
+// Rays still waiting for a cluster at the end of the wave.
+layout(binding = 1, offset = 0) uniform atomic_uint pendingRays;
+
+// Words per slot, then the offsets of the references, triangles and positions within a slot.
+uniform uvec4 slotLayout;
+// Offset of the attributes within a slot.
+uniform uint slotAttributes;
+// Dispatch within the pass: wave 0 starts every ray, later waves continue the pending ones.
+uniform uint wave;
+
+StreamRay startRay(float tMax) {
+    StreamRay ray;
+    ray.t = tMax;
+    ray.reference = NO_HIT;
+    // Before every cluster: entry distances are never negative.
+    ray.resumeT = -1.0;
+    ray.resumeCluster = 0;
+    ray.normal = vec3(0.0);
+    ray.done = 0;
+    return ray;
+}
+
+// 1 + 2 * gamma(3), as in bvh.glsl.
+#define STREAM_BOUNDS_ROUNDING (1.0000004)
+
+// Slab test of bvh.glsl, also returning the (rounded up) exit distance.
+bool intersectSlab(vec3 origin, vec3 inverseDirection, vec3 boundsMin, vec3 boundsMax, float tMax, out float tNear, out float tFar) {
+    vec3 t0 = (boundsMin - origin) * inverseDirection;
+    vec3 t1 = (boundsMax - origin) * inverseDirection;
+    vec3 tSmall = min(t0, t1);
+    vec3 tLarge = max(t0, t1);
+    tNear = max(max(tSmall.x, tSmall.y), max(tSmall.z, 0.0));
+    tFar = min(min(tLarge.x, tLarge.y), min(tLarge.z, tMax)) * STREAM_BOUNDS_ROUNDING;
+    return tNear <= tFar;
+}
+
+vec3 poolVec3(uint word) {
+    return uintBitsToFloat(uvec3(pool[word], pool[word + 1], pool[word + 2]));
+}
+
+// Vertex data of a resident cluster, whose slot starts at word `base`.
+vec3 clusterLocation(uint base, uint triangle, uint corner) {
+    return poolVec3(base + slotLayout.w + 3 * pool[base + slotLayout.z + 3 * triangle + corner]);
+}
+
+vec3 clusterNormal(uint base, uint triangle, uint corner) {
+    return poolVec3(base + slotAttributes + 5 * pool[base + slotLayout.z + 3 * triangle + corner]);
+}
+
+bool intersectClusterPrimitive(uint base, uint reference, vec3 origin, vec3 direction, float tMax, out float t, out vec2 barycentric) {
+    if ((reference & REFERENCE_SPHERE) != 0) {
+        uint index = reference & REFERENCE_INDEX;
+        barycentric = vec2(0.0);
+        return intersectSphere(origin, direction, spheres[index].center, spheres[index].radius, tMax, t);
+    }
+    return intersectTriangle(
+        origin,
+        direction,
+        clusterLocation(base, reference, 0),
+        clusterLocation(base, reference, 1),
+        clusterLocation(base, reference, 2),
+        tMax,
+        t,
+        barycentric
+    );
+}
+
+// Traverses the tree of the resident cluster at `base` up to ray.t and records a closer hit in `ray`.
+// Returns whether there was one; with anyHit, traversal ends at the first.
+bool traceCluster(uint base, vec3 origin, vec3 direction, vec3 inverseDirection, bool anyHit, inout StreamRay ray) {
+    uint nodes = base + SLOT_HEADER;
+    float tLeft, tRight, tFar;
+    if (!intersectSlab(origin, inverseDirection, poolVec3(nodes), poolVec3(nodes + 4), ray.t, tLeft, tFar)) {
+        return false;
+    }
+
+    uint hitReference = NO_HIT;
+    vec2 hitBarycentric = vec2(0.0);
+    uint stack[STREAM_STACK_SIZE];
+    uint stackSize = 0;
+    uint index = 0;
+    while (true) {
+        uint node = nodes + 8 * index;
+        uint first = pool[node + 3];
+        uint count = pool[node + 7];
+        if (count == 0) {
+            uint left = nodes + 8 * first;
+            uint right = left + 8;
+            bool hitLeft = intersectSlab(origin, inverseDirection, poolVec3(left), poolVec3(left + 4), ray.t, tLeft, tFar);
+            bool hitRight = intersectSlab(origin, inverseDirection, poolVec3(right), poolVec3(right + 4), ray.t, tRight, tFar);
+            if (hitLeft && hitRight) {
+                if (tRight < tLeft) {
+                    index = first + 1;
+                    stack[stackSize++] = first;
+                } else {
+                    index = first;
+                    stack[stackSize++] = first + 1;
+                }
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                index = hitLeft ? first : first + 1;
+                continue;
+            }
+        } else {
+            for (uint i = first; i < first + count; ++i) {
+                uint reference = pool[base + slotLayout.y + i];
+                float t;
+                vec2 barycentric;
+                if (intersectClusterPrimitive(base, reference, origin, direction, ray.t, t, barycentric)) {
+                    ray.t = t;
+                    hitReference = reference;
+                    hitBarycentric = barycentric;
+                    if (anyHit) {
+                        ray.reference = reference;
+                        return true;
+                    }
+                }
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        index = stack[--stackSize];
+    }
+    if (hitReference == NO_HIT) {
+        return false;
+    }
+
+    // Attributes are fetched for the closest hit of each cluster, while the cluster is still resident.
+    if ((hitReference & REFERENCE_SPHERE) != 0) {
+        uint sphere = hitReference & REFERENCE_INDEX;
+        ray.reference = hitReference;
+        ray.normal = (origin + ray.t * direction - spheres[sphere].center) / spheres[sphere].radius;
+    } else {
+        // Triangles are numbered across the clusters, not as in the scene.
+        ray.reference = pool[base] + hitReference;
+        ray.normal = normalize(
+            (1.0 - hitBarycentric.x - hitBarycentric.y) * clusterNormal(base, hitReference, 0) +
+            hitBarycentric.x * clusterNormal(base, hitReference, 1) +
+            hitBarycentric.y * clusterNormal(base, hitReference, 2)
+        );
+    }
+    return true;
+}
+
+// Whether cluster (t, index) comes after cluster (afterT, afterIndex) in the visiting order.
+bool clusterAfter(float t, uint index, float afterT, uint afterIndex) {
+    return t > afterT || (t == afterT && index > afterIndex);
+}
+
+// The first cluster after (afterT, afterIndex) in visiting order that the segment up to tMax enters.
+bool nextCluster(vec3 origin, vec3 inverseDirection, float tMax, float afterT, uint afterIndex, out float tNext, out uint next) {
+    tNext = tMax;
+    next = NO_CLUSTER;
+    float tLeft, tRight, tFarLeft, tFarRight;
+    if (!intersectSlab(origin, inverseDirection, clusterNodes[0].min, clusterNodes[0].max, tMax, tLeft, tFarLeft) || tFarLeft < afterT) {
+        return false;
+    }
+
+    uint stack[STREAM_STACK_SIZE];
+    uint stackSize = 0;
+    uint index = 0;
+    while (true) {
+        Node node = clusterNodes[index];
+        if (node.count == 0) {
+            // Subtrees entirely before the resume point or after the best candidate are skipped.
+            uint left = node.first;
+            uint right = node.first + 1;
+            bool hitLeft = intersectSlab(origin, inverseDirection, clusterNodes[left].min, clusterNodes[left].max, tNext, tLeft, tFarLeft) && tFarLeft >= afterT;
+            bool hitRight = intersectSlab(origin, inverseDirection, clusterNodes[right].min, clusterNodes[right].max, tNext, tRight, tFarRight) && tFarRight >= afterT;
+            if (hitLeft && hitRight) {
+                if (tRight < tLeft) {
+                    index = right;
+                    stack[stackSize++] = left;
+                } else {
+                    index = left;
+                    stack[stackSize++] = right;
+                }
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                index = hitLeft ? left : right;
+                continue;
+            }
+        } else {
+            for (uint i = node.first; i < node.first + node.count; ++i) {
+                float tNear, tFar;
+                if (intersectSlab(origin, inverseDirection, clusters[i].min, clusters[i].max, tNext, tNear, tFar) &&
+                    clusterAfter(tNear, i, afterT, afterIndex) && !clusterAfter(tNear, i, tNext, next)) {
+                    tNext = tNear;
+                    next = i;
+                }
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        index = stack[--stackSize];
+    }
+    return next != NO_CLUSTER;
+}
+
+// Continues the ray through the resident clusters. Returns false when it has to wait for a cluster, which is requested,
+// and true when it is finished: there are no more clusters along it or, with anyHit, it hit something.
+bool streamTrace(vec3 origin, vec3 direction, bool anyHit, inout StreamRay ray) {
+    vec3 inverseDirection = 1.0 / direction;
+    float tNear;
+    uint cluster;
+    while (nextCluster(origin, inverseDirection, ray.t, ray.resumeT, ray.resumeCluster, tNear, cluster)) {
+        uint slot = clusters[cluster].slot;
+        if (slot == NOT_RESIDENT) {
+            clusters[cluster].request = REQUEST_LOAD;
+            return false;
+        }
+        // Most rays find the mark already set; reading first saves the writes.
+        if (clusters[cluster].request == 0) {
+            clusters[cluster].request = REQUEST_USED;
+        }
+        ray.resumeT = tNear;
+        ray.resumeCluster = cluster;
+        if (traceCluster(slot * slotLayout.x, origin, direction, inverseDirection, anyHit, ray) && anyHit) {
+            return true;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#version 460 core
+
+// Shadow rays of accelerator::Stream: one wave of var/raytrace/shadow.glsl over the resident clusters (see stream.glsl).
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r8, binding = 2) uniform image2DRect image_shadow;
+
+layout(binding = 0, offset = 0) uniform atomic_uint shadowRayCount;
+
+#include "shading.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "stream.glsl"
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(image_shadow);
+    if (any(greaterThanEqual(pixel, size))) {
+        return;
+    }
+    uint index = uint(pixel.y) * uint(size.x) + uint(pixel.x);
+    StreamRay ray;
+    if (wave == 0) {
+        if (imageLoad(image_trace_index, pixel).x == 0) {
+            rays[index].done = 1;
+            return;
+        }
+        atomicCounterIncrement(shadowRayCount);
+        ray = startRay(1.0);
+    } else {
+        ray = rays[index];
+        if (ray.done != 0) {
+            return;
+        }
+    }
+    vec3 N = imageLoad(image_trace, ivec3(pixel, 1)).xyz;
+    vec3 hitPoint = imageLoad(image_trace, ivec3(pixel, 2)).xyz;
+    vec3 origin = shadowOrigin(hitPoint, N);
+    vec3 direction = shadowDirection(origin);
+
+    if (!streamTrace(origin, direction, true, ray)) {
+        rays[index] = ray;
+        atomicCounterIncrement(pendingRays);
+        return;
+    }
+    rays[index].done = 1;
+    float visibility = ray.reference == NO_HIT ? 1.0 : 0.0;
+    imageStore(image_shadow, pixel, vec4(visibility, 0.0, 0.0, 0.0));
+}
@@ -0,0 +1,49 @@
+#version 460 core
+
+// Primary rays of accelerator::Stream: one wave of var/raytrace/trace.glsl over the resident clusters (see stream.glsl).
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r32f, binding = 2) uniform image2DRect image_depth;
+
+#include "camera.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "stream.glsl"
+#include "gbuffer.glsl"
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(image_depth);
+    if (any(greaterThanEqual(pixel, size))) {
+        return;
+    }
+    uint index = uint(pixel.y) * uint(size.x) + uint(pixel.x);
+    StreamRay ray;
+    if (wave == 0) {
+        ray = startRay(DEPTH_FAR);
+    } else {
+        ray = rays[index];
+        if (ray.done != 0) {
+            return;
+        }
+    }
+    vec3 rayOrigin = cameraOrigin;
+    vec3 rayDirection = cameraRay(pixel);
+
+    if (!streamTrace(rayOrigin, rayDirection, false, ray)) {
+        rays[index] = ray;
+        atomicCounterIncrement(pendingRays);
+        return;
+    }
+    rays[index].done = 1;
+    if (ray.reference == NO_HIT) {
+        storeMiss(pixel);
+        return;
+    }
+
+    vec4 color = (ray.reference & REFERENCE_SPHERE) != 0 ? spheres[ray.reference & REFERENCE_INDEX].color : meshColor;
+    storeSurface(pixel, rayOrigin, rayDirection, ray.t, ray.reference, color, ray.normal);
+}
@@ -0,0 +1,32 @@
+// Shading attributes of the closest hit of a ray. Requires scene.glsl and primitive.glsl.
+
+// Color of every triangle; spheres have their own.
+uniform vec4 meshColor;
+
+struct Surface {
+    vec4 color;
+    // Facing the ray.
+    vec3 normal;
+};
+
+Surface hitSurface(vec3 rayOrigin, vec3 rayDirection, Hit hit) {
+    // Attributes are fetched once, for the closest hit only.
+    uint index = hit.reference & REFERENCE_INDEX;
+    vec3 hitPoint = rayOrigin + hit.t * rayDirection;
+    Surface surface;
+    if ((hit.reference & REFERENCE_SPHERE) != 0) {
+        surface.color = spheres[index].color;
+        surface.normal = (hitPoint - spheres[index].center) / spheres[index].radius;
+    } else {
+        surface.color = meshColor;
+        surface.normal = normalize(
+            (1.0 - hit.barycentric.x - hit.barycentric.y) * vertexNormal(triangleVertex(index, 0)) +
+            hit.barycentric.x * vertexNormal(triangleVertex(index, 1)) +
+            hit.barycentric.y * vertexNormal(triangleVertex(index, 2))
+        );
+    }
+    if (dot(rayDirection, surface.normal) > 0.0) {
+        surface.normal = -surface.normal;
+    }
+    return surface;
+}
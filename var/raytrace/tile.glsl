@@ -0,0 +1,13 @@
+// Screen-space tiling shared by the per-pixel kernels: every invocation is one pixel and every work group is a
+// LOCAL_SIZE_X x LOCAL_SIZE_Y tile. The host may override the tile size when compiling; kernels must bounds check,
+// since the last row and column of tiles hang over the screen edge.
+
+#ifndef LOCAL_SIZE_X
+#define LOCAL_SIZE_X 8
+#endif
+
+#ifndef LOCAL_SIZE_Y
+#define LOCAL_SIZE_Y 8
+#endif
+
+layout(local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = 1) in;
@@ -0,0 +1,30 @@
+#version 460 core
+
+#include "tile.glsl"
+
+layout(rgba32f, binding = 0) uniform image2DArray image_trace;
+layout(r32ui, binding = 1) uniform uimage2DRect image_trace_index;
+layout(r32f, binding = 2) uniform image2DRect image_depth;
+
+#include "camera.glsl"
+#include "scene.glsl"
+#include "primitive.glsl"
+#include "accelerator.glsl"
+#include "gbuffer.glsl"
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, imageSize(image_depth)))) {
+        return;
+    }
+    vec3 rayOrigin = cameraOrigin;
+    vec3 rayDirection = cameraRay(pixel);
+
+    Hit hit = traceClosest(rayOrigin, rayDirection, DEPTH_FAR);
+    if (hit.reference == NO_HIT) {
+        storeMiss(pixel);
+        return;
+    }
+
+    storeHit(pixel, rayOrigin, rayDirection, hit);
+}
@@ -0,0 +1,23 @@
+#version 460 core
+
+#include "../raytrace/scene.glsl"
+#include "../raytrace/shape/sphere.glsl"
+#include "../raytrace/camera.glsl"
+
+// Depth of a point is rasterNear over its distance along the view direction, as for the triangles.
+uniform float rasterNear;
+
+flat in uint sphereIndex;
+
+layout(location = 0) out uint visibility;
+
+void main() {
+    // The box only bounds the sphere: the ray of the pixel decides whether and where it is hit.
+    vec3 direction = cameraRay(ivec2(gl_FragCoord.xy));
+    float t;
+    if (!intersectSphere(cameraOrigin, direction, spheres[sphereIndex].center, spheres[sphereIndex].radius, uintBitsToFloat(0x7F800000u), t)) {
+        discard;
+    }
+    gl_FragDepth = rasterNear / (t * dot(direction, normalize(cameraDirection)));
+    visibility = (sphereIndex | REFERENCE_SPHERE) + 1u;
+}
@@ -0,0 +1,29 @@
+#version 460 core
+
+#include "../raytrace/scene.glsl"
+
+uniform mat4 viewProjection;
+
+flat out uint sphereIndex;
+
+// The box around the unit sphere, as 12 triangles. Both sides of the box are drawn: the fragment shader computes the
+// same hit for either, and the back faces still cover the sphere when the eye is inside the box.
+const vec3 boxCorners[8] = vec3[](
+    vec3(-1.0, -1.0, -1.0), vec3(1.0, -1.0, -1.0), vec3(-1.0, 1.0, -1.0), vec3(1.0, 1.0, -1.0),
+    vec3(-1.0, -1.0, 1.0), vec3(1.0, -1.0, 1.0), vec3(-1.0, 1.0, 1.0), vec3(1.0, 1.0, 1.0)
+);
+
+const int boxIndices[36] = int[](
+    0, 2, 1, 1, 2, 3,
+    4, 5, 6, 5, 7, 6,
+    0, 1, 4, 1, 5, 4,
+    2, 6, 3, 3, 6, 7,
+    0, 4, 2, 2, 4, 6,
+    1, 3, 5, 3, 7, 5
+);
+
+void main() {
+    sphereIndex = uint(gl_InstanceID);
+    Sphere sphere = spheres[gl_InstanceID];
+    gl_Position = viewProjection * vec4(sphere.center + sphere.radius * boxCorners[boxIndices[gl_VertexID]], 1.0);
+}
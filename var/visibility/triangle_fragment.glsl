@@ -0,0 +1,9 @@
+#version 460 core
+
+// The id of the visible primitive, like the trace index: its reference + 1.
+layout(location = 0) out uint visibility;
+
+void main() {
+    // Without a geometry shader, the primitive id of one indexed draw over all triangles is the triangle index.
+    visibility = uint(gl_PrimitiveID) + 1u;
+}
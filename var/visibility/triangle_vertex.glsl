@@ -0,0 +1,11 @@
+#version 460 core
+
+// Vertices are pulled from the storage buffers of the trace kernels, in whatever layout they have (see scene.glsl).
+#include "../raytrace/scene.glsl"
+
+// Clip space of the camera rays: pixel centers sample the point each ray goes through, depth is reversed.
+uniform mat4 viewProjection;
+
+void main() {
+    gl_Position = viewProjection * vec4(vertexLocation(uint(gl_VertexID)), 1.0);
+}